@@ -0,0 +1,79 @@
+#include "benchmarks.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+const char *benchmarkCorpusName(BenchmarkCorpus corpus)
+{
+    return corpus == BENCHMARK_CORPUS_FLAT ? "flat" : "photographic";
+}
+
+static unsigned int benchmarkNoise(unsigned int x, unsigned int y)
+{
+    unsigned int h = x * 374761393U + y * 668265263U;
+    h = (h ^ (h >> 13)) * 1274126177U;
+    return h ^ (h >> 16);
+}
+
+std::vector<unsigned char> benchmarkImage(BenchmarkCorpus corpus, unsigned int width, unsigned int height)
+{
+    std::vector<unsigned char> pixels(width * height * 4);
+    for (unsigned int y = 0; y < height; y++)
+    {
+        for (unsigned int x = 0; x < width; x++)
+        {
+            unsigned char *p = &pixels[(y * width + x) * 4];
+            if (corpus == BENCHMARK_CORPUS_PHOTOGRAPHIC)
+            {
+                unsigned int noise = benchmarkNoise(x, y);
+                p[0] = (unsigned char)std::min(255U, x * 224 / width + (noise & 31));
+                p[1] = (unsigned char)std::min(255U, y * 224 / height + ((noise >> 8) & 31));
+                p[2] = (unsigned char)std::min(255U, (x + y) * 112 / (width + height) * 2 + ((noise >> 16) & 31));
+                p[3] = (unsigned char)std::min(255U, 160 + x * 64 / width + ((noise >> 24) & 31));
+            }
+            else
+            {
+                // A solid background with panels which don't align to blocks, and a repeated glyph-like pattern
+                unsigned char color[4] = {24, 28, 36, 255};
+                if ((x * 7 / width) % 2 == 1 && (y * 5 / height) % 2 == 1)
+                {
+                    color[0] = 220; color[1] = 96; color[2] = 32;
+                }
+                if (y > height / 8 && y < height / 8 + 96 && ((x / 3) % 11 < 4 || ((x + y) / 5) % 13 == 0))
+                {
+                    color[0] = 255; color[1] = 255; color[2] = 255;
+                }
+                std::copy(color, color + 4, p);
+            }
+        }
+    }
+    return pixels;
+}
+
+double benchmarkMilliseconds(int repeats, const std::function<void()>& work)
+{
+    double fastest = 0.0;
+    for (int i = 0; i < repeats; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        work();
+        double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || elapsed < fastest)
+        {
+            fastest = elapsed;
+        }
+    }
+    return fastest;
+}
+
+std::vector<unsigned int> benchmarkThreadCounts()
+{
+    unsigned int cores = std::max(std::thread::hardware_concurrency(), 1U);
+    std::vector<unsigned int> counts;
+    for (unsigned int count = 1; count < cores; count *= 2)
+    {
+        counts.push_back(count);
+    }
+    counts.push_back(cores);
+    return counts;
+}
@@ -0,0 +1,63 @@
+#include "ofMain.h"
+#include "benchmarks.h"
+
+#define kChunkingBenchmarkRepeats 10
+
+/*
+ Save and decode times for fixed and automatic chunk counts, using every core. The chunk count used is read back from
+ a saved file.
+ */
+void benchmarkChunking()
+{
+    struct Size {
+        const char *name;
+        unsigned int width;
+        unsigned int height;
+    };
+    const Size sizes[] = {
+        {"512x512", 512, 512},
+        {"1080p", 1920, 1080},
+        {"4K", 3840, 2160},
+        {"8K", 7680, 4320}
+    };
+    // 0 is the automatic chunk count
+    const unsigned int policies[] = {1, 4, 16, 0};
+    std::string path = ofToDataPath("benchmark_chunking." + ofxHapImage::HapImageFileExtension());
+    for (const Size& size : sizes)
+    {
+        std::vector<unsigned char> pixels = benchmarkImage(BENCHMARK_CORPUS_PHOTOGRAPHIC, size.width, size.height);
+        for (unsigned int policy : policies)
+        {
+            ofxHapImage encoder;
+            encoder.setEncodeQuality(ofxHapImage::ENCODE_QUALITY_FAST);
+            if (policy == 0)
+            {
+                encoder.setAutomaticChunkCount();
+            }
+            else
+            {
+                encoder.setChunkCount(policy);
+            }
+            encoder.loadImage(pixels.data(), size.width, size.height, size.width * 4, ofxHapImage::PIXEL_LAYOUT_RGBA, ofxHapImage::IMAGE_TYPE_HAP);
+            ofBuffer frame;
+            double save_ms = benchmarkMilliseconds(kChunkingBenchmarkRepeats, [&] {
+                encoder.saveImage(frame);
+            });
+            encoder.saveImage(path);
+            ofxHapImage::Info info;
+            if (!ofxHapImage::probe(path, info))
+            {
+                ofLogError("benchmark_ofxHapImage") << "Couldn't probe " << path;
+                continue;
+            }
+
+            ofxHapImage image;
+            image.loadImage(frame);
+            double decode_ms = benchmarkMilliseconds(kChunkingBenchmarkRepeats, [&] {
+                image.loadImage(frame);
+            });
+            ofLogNotice("benchmark_ofxHapImage") << size.name << ", " << (policy == 0 ? "automatic" : ofToString(policy)) << " (" << info.chunkCount << " chunks): save " << save_ms << " ms, decode " << decode_ms << " ms";
+        }
+    }
+    ofFile::removeFile(path);
+}
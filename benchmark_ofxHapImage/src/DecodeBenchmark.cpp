@@ -0,0 +1,40 @@
+#include "ofMain.h"
+#include "benchmarks.h"
+
+#define kDecodeBenchmarkWidth 3840
+#define kDecodeBenchmarkHeight 2160
+#define kDecodeBenchmarkRepeats 20
+
+/*
+ Decode throughput of a 4K frame for each thread count, as chunked frames are decoded a chunk per task
+ */
+void benchmarkDecode()
+{
+    std::vector<unsigned char> pixels = benchmarkImage(BENCHMARK_CORPUS_PHOTOGRAPHIC, kDecodeBenchmarkWidth, kDecodeBenchmarkHeight);
+    const unsigned int chunk_counts[] = {4, 16, 64};
+    const ofxHapImage::ImageType types[] = {ofxHapImage::IMAGE_TYPE_HAP, ofxHapImage::IMAGE_TYPE_HAP_ALPHA, ofxHapImage::IMAGE_TYPE_HAP_Q};
+    for (ofxHapImage::ImageType type : types)
+    {
+        for (unsigned int chunk_count : chunk_counts)
+        {
+            ofxHapImage encoder;
+            encoder.setEncodeQuality(ofxHapImage::ENCODE_QUALITY_FAST);
+            encoder.setChunkCount(chunk_count);
+            encoder.loadImage(pixels.data(), kDecodeBenchmarkWidth, kDecodeBenchmarkHeight, kDecodeBenchmarkWidth * 4, ofxHapImage::PIXEL_LAYOUT_RGBA, type);
+            ofBuffer frame;
+            encoder.saveImage(frame);
+
+            ofxHapImage image;
+            for (unsigned int thread_count : benchmarkThreadCounts())
+            {
+                ofxHapImage::setThreadCount(thread_count);
+                image.loadImage(frame);
+                double ms = benchmarkMilliseconds(kDecodeBenchmarkRepeats, [&] {
+                    image.loadImage(frame);
+                });
+                ofLogNotice("benchmark_ofxHapImage") << ofxHapImage::imageTypeDescription(type) << " 4K, " << chunk_count << " chunks, " << thread_count << " threads: " << ms << " ms, " << 1000.0 / ms << " frames/s";
+            }
+        }
+    }
+    ofxHapImage::setThreadCount(0);
+}
@@ -0,0 +1,48 @@
+#include "ofMain.h"
+#include "benchmarks.h"
+
+/*
+ Encode time at the default quality for common frame sizes, with one thread and with every core. Output is the same
+ for any thread count, so only the time changes.
+ */
+void benchmarkEncode()
+{
+    struct Size {
+        const char *name;
+        unsigned int width;
+        unsigned int height;
+    };
+    const Size sizes[] = {
+        {"1080p", 1920, 1080},
+        {"4K", 3840, 2160},
+        {"8K", 7680, 4320}
+    };
+    const ofxHapImage::ImageType types[] = {ofxHapImage::IMAGE_TYPE_HAP, ofxHapImage::IMAGE_TYPE_HAP_ALPHA, ofxHapImage::IMAGE_TYPE_HAP_Q};
+    std::vector<unsigned int> thread_counts(1, 1);
+    if (benchmarkThreadCounts().back() > 1)
+    {
+        thread_counts.push_back(benchmarkThreadCounts().back());
+    }
+    for (const Size& size : sizes)
+    {
+        std::vector<unsigned char> pixels = benchmarkImage(BENCHMARK_CORPUS_PHOTOGRAPHIC, size.width, size.height);
+        for (ofxHapImage::ImageType type : types)
+        {
+            double single = 0.0;
+            for (unsigned int thread_count : thread_counts)
+            {
+                ofxHapImage::setThreadCount(thread_count);
+                ofxHapImage image;
+                double ms = benchmarkMilliseconds(1, [&] {
+                    image.loadImage(pixels.data(), size.width, size.height, size.width * 4, ofxHapImage::PIXEL_LAYOUT_RGBA, type);
+                });
+                if (thread_count == 1)
+                {
+                    single = ms;
+                }
+                ofLogNotice("benchmark_ofxHapImage") << ofxHapImage::imageTypeDescription(type) << " " << size.name << ", " << thread_count << " threads: " << ms << " ms, " << single / ms << "x";
+            }
+        }
+    }
+    ofxHapImage::setThreadCount(0);
+}
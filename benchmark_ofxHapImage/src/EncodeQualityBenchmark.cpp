@@ -0,0 +1,70 @@
+#include "ofMain.h"
+#include "benchmarks.h"
+#include <cmath>
+
+#define kEncodeQualityBenchmarkWidth 1920
+#define kEncodeQualityBenchmarkHeight 1080
+#define kEncodeQualityBenchmarkRepeats 3
+
+/*
+ PSNR of the decoded image against the source, over RGBA for IMAGE_TYPE_HAP_ALPHA and RGB otherwise
+ */
+static double encodeQualityPSNR(const std::vector<unsigned char>& source, const std::vector<unsigned char>& decoded, ofxHapImage::ImageType type)
+{
+    int channels = type == ofxHapImage::IMAGE_TYPE_HAP_ALPHA ? 4 : 3;
+    double sum = 0.0;
+    for (size_t i = 0; i < source.size(); i++)
+    {
+        if ((int)(i % 4) < channels)
+        {
+            double difference = (double)source[i] - (double)decoded[i];
+            sum += difference * difference;
+        }
+    }
+    double mse = sum / ((double)(source.size() / 4) * channels);
+    return mse == 0.0 ? INFINITY : 10.0 * std::log10(255.0 * 255.0 / mse);
+}
+
+/*
+ Time per frame and PSNR for each encode quality on photographic and flat images. Flat images, with many uniform and
+ repeated blocks, show the effect of the encoders reusing the output of blocks they have already seen.
+ */
+void benchmarkEncodeQuality()
+{
+    struct Quality {
+        const char *name;
+        ofxHapImage::EncodeQuality quality;
+    };
+    const Quality qualities[] = {
+        {"fast", ofxHapImage::ENCODE_QUALITY_FAST},
+        {"range fit", ofxHapImage::ENCODE_QUALITY_RANGE_FIT},
+        {"adaptive", ofxHapImage::ENCODE_QUALITY_ADAPTIVE},
+        {"cluster fit", ofxHapImage::ENCODE_QUALITY_CLUSTER_FIT},
+        {"iterative cluster fit", ofxHapImage::ENCODE_QUALITY_ITERATIVE_CLUSTER_FIT}
+    };
+    const ofxHapImage::ImageType types[] = {ofxHapImage::IMAGE_TYPE_HAP, ofxHapImage::IMAGE_TYPE_HAP_ALPHA, ofxHapImage::IMAGE_TYPE_HAP_Q};
+    const BenchmarkCorpus corpora[] = {BENCHMARK_CORPUS_PHOTOGRAPHIC, BENCHMARK_CORPUS_FLAT};
+    for (BenchmarkCorpus corpus : corpora)
+    {
+        std::vector<unsigned char> pixels = benchmarkImage(corpus, kEncodeQualityBenchmarkWidth, kEncodeQualityBenchmarkHeight);
+        std::vector<unsigned char> decoded(pixels.size());
+        for (ofxHapImage::ImageType type : types)
+        {
+            for (const Quality& quality : qualities)
+            {
+                ofxHapImage image;
+                image.setEncodeQuality(quality.quality);
+                double ms = benchmarkMilliseconds(kEncodeQualityBenchmarkRepeats, [&] {
+                    image.loadImage(pixels.data(), kEncodeQualityBenchmarkWidth, kEncodeQualityBenchmarkHeight, kEncodeQualityBenchmarkWidth * 4, ofxHapImage::PIXEL_LAYOUT_RGBA, type);
+                });
+                image.getPixels(decoded.data(), kEncodeQualityBenchmarkWidth * 4);
+                ofLogNotice("benchmark_ofxHapImage") << ofxHapImage::imageTypeDescription(type) << " " << benchmarkCorpusName(corpus) << " 1080p, " << (type == ofxHapImage::IMAGE_TYPE_HAP_Q ? "any quality" : quality.name) << ": " << ms << " ms, PSNR " << encodeQualityPSNR(pixels, decoded, type) << " dB";
+                if (type == ofxHapImage::IMAGE_TYPE_HAP_Q)
+                {
+                    // Hap Q is always encoded the same way
+                    break;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#include "ofMain.h"
+#include "benchmarks.h"
+#include <ImageMath.h>
+#include <YCoCg.h>
+
+#define kImageMathBenchmarkWidth 3840
+#define kImageMathBenchmarkHeight 2160
+#define kImageMathBenchmarkRepeats 20
+
+/*
+ Throughput of the ImageMath_MatrixMultiply8888() paths on one thread, converting a 4K frame to and from CoCgAY as Hap Q
+ encoding and decoding once did. Paths this machine doesn't have are skipped.
+ */
+void benchmarkImageMath()
+{
+    struct Path {
+        const char *name;
+        ImageMathInstructions instructions;
+    };
+    const Path paths[] = {
+        {"scalar", ImageMathInstructions_Scalar},
+        {"SSE2/NEON", ImageMathInstructions_Vector},
+        {"AVX2", ImageMathInstructions_AVX2}
+    };
+    struct Conversion {
+        const char *name;
+        void (*function)(const uint8_t *, uint8_t *, unsigned long, unsigned long, size_t, size_t, int);
+    };
+    const Conversion conversions[] = {
+        {"RGBA to CoCgAY", ConvertRGBAToCoCgAY8888},
+        {"CoCgAY to RGBA", ConvertCoCgAY8888ToRGBA}
+    };
+    std::vector<unsigned char> source = benchmarkImage(BENCHMARK_CORPUS_PHOTOGRAPHIC, kImageMathBenchmarkWidth, kImageMathBenchmarkHeight);
+    std::vector<unsigned char> destination(source.size());
+    const size_t stride = kImageMathBenchmarkWidth * 4;
+    const double megapixels = (kImageMathBenchmarkWidth * kImageMathBenchmarkHeight) / 1000000.0;
+    for (const Conversion& conversion : conversions)
+    {
+        double scalar = 0.0;
+        for (const Path& path : paths)
+        {
+            ImageMath_SetInstructionLimit(path.instructions);
+            if (ImageMath_GetInstructions() != path.instructions)
+            {
+                continue;
+            }
+            double ms = benchmarkMilliseconds(kImageMathBenchmarkRepeats, [&] {
+                conversion.function(source.data(), destination.data(), kImageMathBenchmarkWidth, kImageMathBenchmarkHeight, stride, stride, 0);
+            });
+            if (path.instructions == ImageMathInstructions_Scalar)
+            {
+                scalar = ms;
+            }
+            ofLogNotice("benchmark_ofxHapImage") << conversion.name << " 4K, " << path.name << ": " << ms << " ms, " << megapixels * 1000.0 / ms << " Mpixels/s, " << scalar / ms << "x";
+        }
+    }
+    ImageMath_SetInstructionLimit(ImageMathInstructions_AVX2);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ofxHapImage.h"
+#include <functional>
+#include <vector>
+
+enum BenchmarkCorpus {
+    BENCHMARK_CORPUS_PHOTOGRAPHIC,
+    BENCHMARK_CORPUS_FLAT
+};
+
+const char *benchmarkCorpusName(BenchmarkCorpus corpus);
+
+/*
+ Generates RGBA pixels. BENCHMARK_CORPUS_PHOTOGRAPHIC has smooth gradients with noise in every block, and
+ BENCHMARK_CORPUS_FLAT has large areas of solid color and repeated blocks, like titles and UI graphics. The same
+ arguments always give the same pixels.
+ */
+std::vector<unsigned char> benchmarkImage(BenchmarkCorpus corpus, unsigned int width, unsigned int height);
+
+/*
+ The fastest of repeats runs of work, in milliseconds
+ */
+double benchmarkMilliseconds(int repeats, const std::function<void()>& work);
+
+/*
+ The thread counts to measure scaling with: 1, then doubling up to the number of cores on this machine
+ */
+std::vector<unsigned int> benchmarkThreadCounts();
+
+/*
+ Each benchmark logs its results
+ */
+
+void benchmarkDecode();
+void benchmarkEncode();
+void benchmarkEncodeQuality();
+void benchmarkChunking();
+void benchmarkImageMath();
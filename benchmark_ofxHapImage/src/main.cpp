@@ -0,0 +1,26 @@
+#include "ofMain.h"
+#include "benchmarks.h"
+
+/*
+ Runs without a window and logs timings. Build with optimization, as the release target does.
+ */
+int main()
+{
+    struct Benchmark {
+        const char *name;
+        void (*function)();
+    };
+    const Benchmark benchmarks[] = {
+        {"decode", benchmarkDecode},
+        {"encode", benchmarkEncode},
+        {"encode quality", benchmarkEncodeQuality},
+        {"chunking", benchmarkChunking},
+        {"ImageMath", benchmarkImageMath},
+    };
+    for (const Benchmark& benchmark : benchmarks)
+    {
+        ofLogNotice("benchmark_ofxHapImage") << benchmark.name;
+        benchmark.function();
+    }
+    return 0;
+}
@@ -88,6 +88,17 @@ typedef struct HapChunkDecodeInfo {
     size_t uncompressed_chunk_size;
 } HapChunkDecodeInfo;
 
+/*
+ To encode we use a struct to store details of each chunk
+ */
+typedef struct HapChunkEncodeInfo {
+    unsigned int result;
+    const char *uncompressed_chunk_data;
+    size_t uncompressed_chunk_size;
+    char *compressed_chunk_data;
+    size_t compressed_chunk_size;
+} HapChunkEncodeInfo;
+
 // TODO: rename the defines we use for codes used in stored frames
 // to better differentiate them from the enums used for the API
 
@@ -123,14 +134,17 @@ static void hap_write_4_byte_uint(const void *buffer, unsigned int value)
 
 #define hap_4_bit_packed_byte(top_bits, bottom_bits) (((top_bits) << 4) | ((bottom_bits) & 0x0F))
 
-static int hap_read_section_header(const void *buffer, uint32_t buffer_length, uint32_t *out_header_length, uint32_t *out_section_length, unsigned int *out_section_type)
+/*
+ Reads a section header without requiring the rest of the section to be in the buffer
+ */
+static int hap_read_section_header_only(const void *buffer, uint32_t buffer_length, uint32_t *out_header_length, uint32_t *out_section_length, unsigned int *out_section_type)
 {
     /*
      Verify buffer is big enough to contain a four-byte header
      */
     if (buffer_length < 4U)
     {
-        return HapResult_Bad_Frame;
+        return HapResult_Buffer_Too_Small;
     }
 
     /*
@@ -149,7 +163,7 @@ static int hap_read_section_header(const void *buffer, uint32_t buffer_length, u
          */
         if (buffer_length < 8U)
         {
-            return HapResult_Bad_Frame;
+            return HapResult_Buffer_Too_Small;
         }
         *out_section_length = hap_read_4_byte_uint(((uint8_t *)buffer) + 4U);
         *out_header_length = 8U;
@@ -163,7 +177,18 @@ static int hap_read_section_header(const void *buffer, uint32_t buffer_length, u
      The fourth byte stores the section type
      */
     *out_section_type = *(((uint8_t *)buffer) + 3U);
-    
+
+    return HapResult_No_Error;
+}
+
+static int hap_read_section_header(const void *buffer, uint32_t buffer_length, uint32_t *out_header_length, uint32_t *out_section_length, unsigned int *out_section_type)
+{
+    int result = hap_read_section_header_only(buffer, buffer_length, out_header_length, out_section_length, out_section_type);
+    if (result != HapResult_No_Error)
+    {
+        return HapResult_Bad_Frame;
+    }
+
     /*
      Verify the section does not extend beyond the buffer
      */
@@ -255,9 +280,9 @@ static unsigned int hap_limited_chunk_count_for_frame(size_t input_bytes, unsign
 {
     // This is a hard limit due to the 4-byte headers we use for the decode instruction container
     // (0xFFFFFF == count + (4 x count) + 20)
-    if (chunk_count > 3355431)
+    if (chunk_count > HapMaxChunkCount)
     {
-        chunk_count = 3355431;
+        chunk_count = HapMaxChunkCount;
     }
     // Divide frame equally on DXT block boundries (8 or 16 bytes)
     unsigned long dxt_block_count;
@@ -329,9 +354,29 @@ unsigned long HapMaxEncodedLength(unsigned int count,
     return total_length;
 }
 
+static void hap_encode_chunk(HapChunkEncodeInfo chunks[], unsigned int index)
+{
+    if (chunks)
+    {
+        snappy_status result = snappy_compress(chunks[index].uncompressed_chunk_data,
+                                               chunks[index].uncompressed_chunk_size,
+                                               chunks[index].compressed_chunk_data,
+                                               &chunks[index].compressed_chunk_size);
+        if (result == SNAPPY_OK)
+        {
+            chunks[index].result = HapResult_No_Error;
+        }
+        else
+        {
+            chunks[index].result = HapResult_Internal_Error;
+        }
+    }
+}
+
 static unsigned int hap_encode_texture(const void *inputBuffer, unsigned long inputBufferBytes, unsigned int textureFormat,
-                                       unsigned int compressor, unsigned int chunkCount, void *outputBuffer,
-                                       unsigned long outputBufferBytes, unsigned long *outputBufferBytesUsed)
+                                       unsigned int compressor, unsigned int chunkCount,
+                                       HapEncodeCallback callback, void *info,
+                                       void *outputBuffer, unsigned long outputBufferBytes, unsigned long *outputBufferBytesUsed)
 {
     size_t top_section_header_length;
     size_t top_section_length;
@@ -386,10 +431,12 @@ static unsigned int hap_encode_texture(const void *inputBuffer, unsigned long in
          */
 
         size_t decode_instructions_length;
-        size_t chunk_size, compress_buffer_remaining;
+        size_t chunk_size, chunk_slot_size;
         uint8_t *second_stage_compressor_table;
         void *chunk_size_table;
         char *compressed_data;
+        HapChunkEncodeInfo *chunk_info;
+        unsigned int result = HapResult_No_Error;
         unsigned int i;
 
         chunkCount = hap_limited_chunk_count_for_frame(inputBufferBytes, textureFormat, chunkCount);
@@ -415,38 +462,74 @@ static unsigned int hap_encode_texture(const void *inputBuffer, unsigned long in
 
         compressed_data = (char *)(((uint8_t *)outputBuffer) + top_section_header_length + 4 + decode_instructions_length);
 
-        compress_buffer_remaining = outputBufferBytes - top_section_header_length - 4 - decode_instructions_length;
-
         top_section_length = 4 + decode_instructions_length;
 
+        /*
+         Each chunk is compressed into its own worst-case-sized slot in the output buffer, so chunks can be compressed
+         independently. The space for the slots was guaranteed by the check against hap_max_encoded_length() above.
+         */
+        chunk_slot_size = snappy_max_compressed_length(chunk_size);
+
+        chunk_info = (HapChunkEncodeInfo *)malloc(sizeof(HapChunkEncodeInfo) * chunkCount);
+        if (chunk_info == NULL)
+        {
+            return HapResult_Internal_Error;
+        }
+
+        for (i = 0; i < chunkCount; i++) {
+            chunk_info[i].uncompressed_chunk_data = (const char *)(((uint8_t *)inputBuffer) + (chunk_size * i));
+            chunk_info[i].uncompressed_chunk_size = chunk_size;
+            chunk_info[i].compressed_chunk_data = compressed_data + (chunk_slot_size * i);
+            chunk_info[i].compressed_chunk_size = chunk_slot_size;
+        }
+
+        if (chunkCount == 1 || callback == NULL)
+        {
+            for (i = 0; i < chunkCount; i++) {
+                hap_encode_chunk(chunk_info, i);
+            }
+        }
+        else
+        {
+            callback((HapEncodeWorkFunction)hap_encode_chunk, chunk_info, chunkCount, info);
+        }
+
+        /*
+         Pack the chunks together. A chunk's packed position is never after its slot, and no chunk is longer than its
+         uncompressed size, so chunks which remain to be packed are never overwritten.
+         */
         for (i = 0; i < chunkCount; i++) {
-            size_t chunk_packed_length = compress_buffer_remaining;
-            const char *chunk_input_start = (const char *)(((uint8_t *)inputBuffer) + (chunk_size * i));
-            if (compressor == HapCompressorSnappy)
+            size_t chunk_packed_length = chunk_info[i].compressed_chunk_size;
+
+            if (chunk_info[i].result != HapResult_No_Error)
             {
-                snappy_status result = snappy_compress(chunk_input_start, chunk_size, (char *)compressed_data, &chunk_packed_length);
-                if (result != SNAPPY_OK)
-                {
-                    return HapResult_Internal_Error;
-                }
+                result = chunk_info[i].result;
+                break;
             }
 
-            if (compressor == HapCompressorNone || chunk_packed_length >= chunk_size)
+            if (chunk_packed_length >= chunk_size)
             {
                 // store the chunk uncompressed
-                memcpy(compressed_data, chunk_input_start, chunk_size);
+                memcpy(compressed_data, chunk_info[i].uncompressed_chunk_data, chunk_size);
                 chunk_packed_length = chunk_size;
                 second_stage_compressor_table[i] = kHapCompressorNone;
             }
             else
             {
                 // ie we used snappy and saved some space
+                memmove(compressed_data, chunk_info[i].compressed_chunk_data, chunk_packed_length);
                 second_stage_compressor_table[i] = kHapCompressorSnappy;
             }
             hap_write_4_byte_uint(((uint8_t *)chunk_size_table) + (i * 4), chunk_packed_length);
             compressed_data += chunk_packed_length;
             top_section_length += chunk_packed_length;
-            compress_buffer_remaining -= chunk_packed_length;
+        }
+
+        free(chunk_info);
+
+        if (result != HapResult_No_Error)
+        {
+            return result;
         }
 
         if (top_section_length < inputBufferBytes + top_section_header_length)
@@ -482,6 +565,7 @@ unsigned int HapEncode(unsigned int count,
                        unsigned int *textureFormats,
                        unsigned int *compressors,
                        unsigned int *chunkCounts,
+                       HapEncodeCallback callback, void *info,
                        void *outputBuffer, unsigned long outputBufferBytes,
                        unsigned long *outputBufferBytesUsed)
 {
@@ -518,6 +602,7 @@ unsigned int HapEncode(unsigned int count,
                                   textureFormats[0],
                                   compressors[0],
                                   chunkCounts[0],
+                                  callback, info,
                                   outputBuffer,
                                   outputBufferBytes,
                                   outputBufferBytesUsed);
@@ -559,6 +644,7 @@ unsigned int HapEncode(unsigned int count,
                                                      textureFormats[i],
                                                      compressors[i],
                                                      chunkCounts[i],
+                                                     callback, info,
                                                      section,
                                                      outputBufferBytes - (top_section_header_length + top_section_length),
                                                      &section_length);
@@ -577,6 +663,175 @@ unsigned int HapEncode(unsigned int count,
     }
 }
 
+unsigned int HapLimitedChunkCount(unsigned long inputBytes, unsigned int textureFormat, unsigned int chunkCount)
+{
+    if (chunkCount == 0)
+    {
+        chunkCount = 1;
+    }
+    return hap_limited_chunk_count_for_frame(inputBytes, textureFormat, chunkCount);
+}
+
+/*
+ As hap_encode_texture() chooses a top section header length, based on the worst-case size of the section
+ */
+static size_t hap_stream_top_section_header_length(size_t input_bytes, unsigned int chunk_count)
+{
+    if (input_bytes > kHapUInt24Max || (input_bytes + hap_decode_instructions_length(chunk_count) + 4) > kHapUInt24Max)
+    {
+        return 8U;
+    }
+    return 4U;
+}
+
+unsigned long HapStreamHeaderLength(unsigned long inputBufferBytes, unsigned int chunkCount)
+{
+    if (inputBufferBytes == 0 || chunkCount == 0 || chunkCount > HapMaxChunkCount)
+    {
+        return 0;
+    }
+    // top section header + decode instructions section header + decode instructions
+    return hap_stream_top_section_header_length(inputBufferBytes, chunkCount) + 4U + hap_decode_instructions_length(chunkCount);
+}
+
+unsigned int HapEncodeStreamHeader(unsigned long inputBufferBytes, unsigned int textureFormat, unsigned int chunkCount,
+                                   const unsigned int *chunkCompressors,
+                                   const unsigned long *chunkSizes,
+                                   void *outputBuffer, unsigned long outputBufferBytes,
+                                   unsigned long *outputBufferBytesUsed,
+                                   unsigned int *outputCompressor)
+{
+    size_t header_length = HapStreamHeaderLength(inputBufferBytes, chunkCount);
+    size_t top_section_header_length = hap_stream_top_section_header_length(inputBufferBytes, chunkCount);
+    size_t decode_instructions_length = hap_decode_instructions_length(chunkCount);
+    unsigned int storedFormat = hap_texture_format_identifier_for_format_constant(textureFormat);
+    uint8_t *compressor_table;
+    uint8_t *chunk_size_table;
+    uint64_t top_section_length;
+    unsigned int i;
+
+    if (header_length == 0
+        || storedFormat == 0
+        || outputBuffer == NULL
+        || outputBufferBytesUsed == NULL)
+    {
+        return HapResult_Bad_Arguments;
+    }
+    else if (outputBufferBytes < header_length)
+    {
+        return HapResult_Buffer_Too_Small;
+    }
+
+    compressor_table = ((uint8_t *)outputBuffer) + top_section_header_length + 4U + 4U;
+    chunk_size_table = compressor_table + chunkCount + 4U;
+
+    // write the Decode Instructions section header
+    hap_write_section_header(((uint8_t *)outputBuffer) + top_section_header_length, 4U, decode_instructions_length, kHapSectionDecodeInstructionsContainer);
+    // write the Second Stage Compressor Table section header
+    hap_write_section_header(compressor_table - 4U, 4U, chunkCount, kHapSectionChunkSecondStageCompressorTable);
+    // write the Chunk Size Table section header
+    hap_write_section_header(chunk_size_table - 4U, 4U, chunkCount * 4U, kHapSectionChunkSizeTable);
+
+    /*
+     Fill the tables, using zeroes for any values which aren't known yet
+     */
+    top_section_length = 4U + decode_instructions_length;
+    for (i = 0; i < chunkCount; i++) {
+        unsigned int compressor = chunkCompressors ? chunkCompressors[i] : HapCompressorNone;
+        uint64_t size = chunkSizes ? chunkSizes[i] : 0;
+
+        if (compressor != HapCompressorNone && compressor != HapCompressorSnappy)
+        {
+            return HapResult_Bad_Arguments;
+        }
+        compressor_table[i] = (compressor == HapCompressorSnappy ? kHapCompressorSnappy : kHapCompressorNone);
+        hap_write_4_byte_uint(chunk_size_table + (i * 4), (unsigned int)size);
+        top_section_length += size;
+    }
+
+    /*
+     A section's length is stored in four bytes, which limits a frame to 4 GB
+     */
+    if ((top_section_header_length == 4U && top_section_length > kHapUInt24Max) || top_section_length > UINT32_MAX)
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    if (outputCompressor != NULL && chunkSizes != NULL && top_section_length >= inputBufferBytes + top_section_header_length)
+    {
+        // As HapEncode() does, signal to store the frame uncompressed because snappy compression saved no space
+        hap_write_section_header(outputBuffer, top_section_header_length, inputBufferBytes, hap_4_bit_packed_byte(kHapCompressorNone, storedFormat));
+        *outputBufferBytesUsed = top_section_header_length;
+        *outputCompressor = HapCompressorNone;
+    }
+    else
+    {
+        hap_write_section_header(outputBuffer, top_section_header_length, (uint32_t)top_section_length, hap_4_bit_packed_byte(kHapCompressorComplex, storedFormat));
+        *outputBufferBytesUsed = header_length;
+        if (outputCompressor != NULL)
+        {
+            *outputCompressor = HapCompressorSnappy;
+        }
+    }
+
+    return HapResult_No_Error;
+}
+
+unsigned long HapMaxEncodedChunkLength(unsigned long inputBufferBytes)
+{
+    return snappy_max_compressed_length(inputBufferBytes);
+}
+
+unsigned int HapEncodeChunk(const void *inputBuffer, unsigned long inputBufferBytes,
+                            unsigned int compressor,
+                            void *outputBuffer, unsigned long outputBufferBytes,
+                            unsigned long *outputBufferBytesUsed,
+                            unsigned int *outputCompressor)
+{
+    if (inputBuffer == NULL
+        || inputBufferBytes == 0
+        || (compressor != HapCompressorNone
+            && compressor != HapCompressorSnappy
+            )
+        || (compressor == HapCompressorSnappy && outputBuffer == NULL)
+        || outputBufferBytesUsed == NULL
+        || outputCompressor == NULL)
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    if (compressor == HapCompressorSnappy)
+    {
+        size_t compressed_length = outputBufferBytes;
+        snappy_status result;
+
+        if (outputBufferBytes < snappy_max_compressed_length(inputBufferBytes))
+        {
+            return HapResult_Buffer_Too_Small;
+        }
+
+        result = snappy_compress((const char *)inputBuffer, inputBufferBytes, (char *)outputBuffer, &compressed_length);
+        if (result != SNAPPY_OK)
+        {
+            return HapResult_Internal_Error;
+        }
+
+        if (compressed_length < inputBufferBytes)
+        {
+            // ie we used snappy and saved some space
+            *outputBufferBytesUsed = compressed_length;
+            *outputCompressor = HapCompressorSnappy;
+            return HapResult_No_Error;
+        }
+    }
+
+    // store the chunk uncompressed
+    *outputBufferBytesUsed = inputBufferBytes;
+    *outputCompressor = HapCompressorNone;
+
+    return HapResult_No_Error;
+}
+
 static void hap_decode_chunk(HapChunkDecodeInfo chunks[], unsigned int index)
 {
     if (chunks)
@@ -615,278 +870,427 @@ static void hap_decode_chunk(HapChunkDecodeInfo chunks[], unsigned int index)
     }
 }
 
-unsigned int hap_decode_single_texture(const void *texture_section, uint32_t texture_section_length,
-                                       unsigned int texture_section_type,
-                                       HapDecodeCallback callback, void *info,
-                                       void *outputBuffer, unsigned long outputBufferBytes,
-                                       unsigned long *outputBufferBytesUsed,
-                                       unsigned int *outputBufferTextureFormat)
+/*
+ The chunk tables of a texture section using the complex second-stage compressor, and the start of its chunk data
+ */
+typedef struct HapDecodeInstructions {
+    int chunk_count;
+    const void *compressors;
+    const void *chunk_sizes;
+    const void *chunk_offsets;
+    const char *frame_data;
+} HapDecodeInstructions;
+
+static int hap_read_decode_instructions(const void *texture_section, uint32_t texture_section_length, HapDecodeInstructions *instructions)
 {
-    int result = HapResult_No_Error;
-    unsigned int textureFormat;
-    unsigned int compressor;
-    size_t bytesUsed = 0;
+    int result;
+    const void *section_start;
+    uint32_t section_header_length;
+    uint32_t section_length;
+    unsigned int section_type;
+    const char *frame_data = NULL;
+    size_t bytes_remaining = 0;
 
-    /*
-     One top-level section type describes texture-format and second-stage compression
-     Hap compressor/format constants can be unpacked by reading the top and bottom four bits.
-     */
-    compressor = hap_top_4_bits(texture_section_type);
-    textureFormat = hap_bottom_4_bits(texture_section_type);
+    int chunk_count = 0;
+    const void *compressors = NULL;
+    const void *chunk_sizes = NULL;
+    const void *chunk_offsets = NULL;
 
     /*
-     Pass the texture format out
+     The top-level section should contain a Decode Instructions Container followed by frame data
      */
-    *outputBufferTextureFormat = hap_texture_format_constant_for_format_identifier(textureFormat);
-    if (*outputBufferTextureFormat == 0)
+    result = hap_read_section_header(texture_section, texture_section_length, &section_header_length, &section_length, &section_type);
+
+    if (result == HapResult_No_Error && section_type != kHapSectionDecodeInstructionsContainer)
     {
-        return HapResult_Bad_Frame;
+        result = HapResult_Bad_Frame;
     }
 
-    if (compressor == kHapCompressorComplex)
+    if (result != HapResult_No_Error)
     {
-        /*
-         The top-level section should contain a Decode Instructions Container followed by frame data
-         */
-        const void *section_start;
-        uint32_t section_header_length;
-        uint32_t section_length;
-        unsigned int section_type;
-        const char *frame_data = NULL;
-        size_t bytes_remaining = 0;
-
-        int chunk_count = 0;
-        const void *compressors = NULL;
-        const void *chunk_sizes = NULL;
-        const void *chunk_offsets = NULL;
+        return result;
+    }
 
-        result = hap_read_section_header(texture_section, texture_section_length, &section_header_length, &section_length, &section_type);
+    /*
+     Frame data follows immediately after the Decode Instructions Container
+     */
+    frame_data = ((const char *)texture_section) + section_header_length + section_length;
 
-        if (result == HapResult_No_Error && section_type != kHapSectionDecodeInstructionsContainer)
-        {
-            result = HapResult_Bad_Frame;
-        }
+    /*
+     Step through the sections inside the Decode Instructions Container
+     */
+    section_start = ((uint8_t *)texture_section) + section_header_length;
+    bytes_remaining = section_length;
 
+    while (bytes_remaining > 0) {
+        unsigned int section_chunk_count = 0;
+        result = hap_read_section_header(section_start, bytes_remaining, &section_header_length, &section_length, &section_type);
         if (result != HapResult_No_Error)
         {
             return result;
         }
-
-        /*
-         Frame data follows immediately after the Decode Instructions Container
-         */
-        frame_data = ((const char *)texture_section) + section_header_length + section_length;
-
-        /*
-         Step through the sections inside the Decode Instructions Container
-         */
-        section_start = ((uint8_t *)texture_section) + section_header_length;
-        bytes_remaining = section_length;
-
-        while (bytes_remaining > 0) {
-            unsigned int section_chunk_count = 0;
-            result = hap_read_section_header(section_start, bytes_remaining, &section_header_length, &section_length, &section_type);
-            if (result != HapResult_No_Error)
-            {
-                return result;
-            }
-            section_start = ((uint8_t *)section_start) + section_header_length;
-            switch (section_type) {
-                case kHapSectionChunkSecondStageCompressorTable:
-                    compressors = section_start;
-                    section_chunk_count = section_length;
-                    break;
-                case kHapSectionChunkSizeTable:
-                    chunk_sizes = section_start;
-                    section_chunk_count = section_length / 4;
-                    break;
-                case kHapSectionChunkOffsetTable:
-                    chunk_offsets = section_start;
-                    section_chunk_count = section_length / 4;
-                    break;
-                default:
-                    // Ignore unrecognized sections
-                    break;
-            }
-
-            /*
-             If we calculated a chunk count and already have one, make sure they match
-             */
-            if (section_chunk_count != 0)
-            {
-                if (chunk_count != 0 && section_chunk_count != chunk_count)
-                {
-                    return HapResult_Bad_Frame;
-                }
-                chunk_count = section_chunk_count;
-            }
-
-            section_start = ((uint8_t *)section_start) + section_length;
-            bytes_remaining -= section_header_length + section_length;
+        section_start = ((uint8_t *)section_start) + section_header_length;
+        switch (section_type) {
+            case kHapSectionChunkSecondStageCompressorTable:
+                compressors = section_start;
+                section_chunk_count = section_length;
+                break;
+            case kHapSectionChunkSizeTable:
+                chunk_sizes = section_start;
+                section_chunk_count = section_length / 4;
+                break;
+            case kHapSectionChunkOffsetTable:
+                chunk_offsets = section_start;
+                section_chunk_count = section_length / 4;
+                break;
+            default:
+                // Ignore unrecognized sections
+                break;
         }
 
         /*
-         The Chunk Second-Stage Compressor Table and Chunk Size Table are required
+         If we calculated a chunk count and already have one, make sure they match
          */
-        if (compressors == NULL || chunk_sizes == NULL)
-        {
-            return HapResult_Bad_Frame;
-        }
-
-        if (chunk_count > 0)
+        if (section_chunk_count != 0)
         {
-            /*
-             Step through the chunks, storing information for their decompression
-             */
-            HapChunkDecodeInfo *chunk_info = (HapChunkDecodeInfo *)malloc(sizeof(HapChunkDecodeInfo) * chunk_count);
-
-            size_t running_compressed_chunk_size = 0;
-            size_t running_uncompressed_chunk_size = 0;
-            int i;
-
-            if (chunk_info == NULL)
+            if (chunk_count != 0 && section_chunk_count != chunk_count)
             {
-                return HapResult_Internal_Error;
-            }
-
-            for (i = 0; i < chunk_count; i++) {
-
-                chunk_info[i].compressor = *(((uint8_t *)compressors) + i);
-
-                chunk_info[i].compressed_chunk_size = hap_read_4_byte_uint(((uint8_t *)chunk_sizes) + (i * 4));
-
-                if (chunk_offsets)
-                {
-                    chunk_info[i].compressed_chunk_data = frame_data + hap_read_4_byte_uint(((uint8_t *)chunk_offsets) + (i * 4));
-                }
-                else
-                {
-                    chunk_info[i].compressed_chunk_data = frame_data + running_compressed_chunk_size;
-                }
-
-                running_compressed_chunk_size += chunk_info[i].compressed_chunk_size;
-
-                if (chunk_info[i].compressor == kHapCompressorSnappy)
-                {
-                    snappy_status snappy_result = snappy_uncompressed_length(chunk_info[i].compressed_chunk_data,
-                        chunk_info[i].compressed_chunk_size,
-                        &(chunk_info[i].uncompressed_chunk_size));
-
-                    if (snappy_result != SNAPPY_OK)
-                    {
-                        switch (snappy_result)
-                        {
-                        case SNAPPY_INVALID_INPUT:
-                            result = HapResult_Bad_Frame;
-                            break;
-                        default:
-                            result = HapResult_Internal_Error;
-                            break;
-                        }
-                        break;
-                    }
-                }
-                else
-                {
-                    chunk_info[i].uncompressed_chunk_size = chunk_info[i].compressed_chunk_size;
-                }
-
-                chunk_info[i].uncompressed_chunk_data = (char *)(((uint8_t *)outputBuffer) + running_uncompressed_chunk_size);
-                running_uncompressed_chunk_size += chunk_info[i].uncompressed_chunk_size;
+                return HapResult_Bad_Frame;
             }
+            chunk_count = section_chunk_count;
+        }
 
-            if (result == HapResult_No_Error && running_uncompressed_chunk_size > outputBufferBytes)
-            {
-                result = HapResult_Buffer_Too_Small;
-            }
+        section_start = ((uint8_t *)section_start) + section_length;
+        bytes_remaining -= section_header_length + section_length;
+    }
 
-            if (result == HapResult_No_Error)
-            {
-                /*
-                 Perform decompression
-                 */
-                bytesUsed = running_uncompressed_chunk_size;
-
-                if (chunk_count == 1)
-                {
-                    /*
-                     We don't invoke the callback for one chunk, just decode it directly
-                     */
-                    hap_decode_chunk(chunk_info, 0);
-                }
-                else
-                {
-                    callback((HapDecodeWorkFunction)hap_decode_chunk, chunk_info, chunk_count, info);
-                }
-
-                /*
-                 Check to see if we encountered any errors and report one of them
-                 */
-                for (i = 0; i < chunk_count; i++)
-                {
-                    if (chunk_info[i].result != HapResult_No_Error)
-                    {
-                        result = chunk_info[i].result;
-                        break;
-                    }
-                }
-            }
+    /*
+     The Chunk Second-Stage Compressor Table and Chunk Size Table are required
+     */
+    if (compressors == NULL || chunk_sizes == NULL)
+    {
+        return HapResult_Bad_Frame;
+    }
 
-            free(chunk_info);
+    instructions->chunk_count = chunk_count;
+    instructions->compressors = compressors;
+    instructions->chunk_sizes = chunk_sizes;
+    instructions->chunk_offsets = chunk_offsets;
+    instructions->frame_data = frame_data;
+    return HapResult_No_Error;
+}
 
-            if (result != HapResult_No_Error)
-            {
-                return result;
-            }
-        }
-    }
-    else if (compressor == kHapCompressorSnappy)
+/*
+ Finds a chunk of a parsed texture. running_length is the total stored length of the chunks before it, which locates it
+ when the texture has no Chunk Offset Table.
+ */
+static void hap_read_texture_chunk(const HapTextureDescriptor *texture, unsigned int index, size_t running_length,
+                                   unsigned int *compressor, const char **data, size_t *length)
+{
+    if (texture->chunkCompressors)
     {
-        /*
-         Only one section is present containing a single block of snappy-compressed texture data
-         */
-        snappy_status snappy_result = snappy_uncompressed_length((const char *)texture_section, texture_section_length, &bytesUsed);
-        if (snappy_result != SNAPPY_OK)
-        {
-            return HapResult_Internal_Error;
-        }
-        if (bytesUsed > outputBufferBytes)
+        *compressor = *(((const uint8_t *)texture->chunkCompressors) + index);
+        *length = hap_read_4_byte_uint(((const uint8_t *)texture->chunkSizes) + (index * 4));
+        if (texture->chunkOffsets)
         {
-            return HapResult_Buffer_Too_Small;
+            *data = ((const char *)texture->chunkData) + hap_read_4_byte_uint(((const uint8_t *)texture->chunkOffsets) + (index * 4));
         }
-        snappy_result = snappy_uncompress((const char *)texture_section, texture_section_length, (char *)outputBuffer, &bytesUsed);
-        if (snappy_result != SNAPPY_OK)
+        else
         {
-            return HapResult_Internal_Error;
+            *data = ((const char *)texture->chunkData) + running_length;
         }
     }
-    else if (compressor == kHapCompressorNone)
+    else
     {
         /*
-         Only one section is present containing a single block of uncompressed texture data
+         A texture which isn't chunked is one chunk filling its section
          */
-        bytesUsed = texture_section_length;
-        if (texture_section_length > outputBufferBytes)
-        {
-            return HapResult_Buffer_Too_Small;
+        *compressor = texture->sectionCompressor;
+        *length = texture->sectionBytes;
+        *data = (const char *)texture->section;
+    }
+}
+
+static int hap_chunk_uncompressed_length(unsigned int compressor, const char *data, size_t length, size_t *uncompressed_length)
+{
+    if (compressor == kHapCompressorSnappy)
+    {
+        snappy_status snappy_result = snappy_uncompressed_length(data, length, uncompressed_length);
+        switch (snappy_result)
+        {
+            case SNAPPY_OK:
+                return HapResult_No_Error;
+            case SNAPPY_INVALID_INPUT:
+                return HapResult_Bad_Frame;
+            default:
+                return HapResult_Internal_Error;
+        }
+    }
+    else if (compressor == kHapCompressorNone)
+    {
+        *uncompressed_length = length;
+        return HapResult_No_Error;
+    }
+    else
+    {
+        return HapResult_Bad_Frame;
+    }
+}
+
+/*
+ Reads a texture section's type and chunk tables, and checks and measures its chunks
+ */
+static int hap_parse_texture(const void *texture_section, uint32_t texture_section_length,
+                             unsigned int texture_section_type,
+                             HapTextureDescriptor *texture)
+{
+    int result;
+    unsigned int i;
+    size_t running_compressed_length = 0;
+    size_t running_uncompressed_length = 0;
+    int contiguous = 1;
+
+    /*
+     One top-level section type describes texture-format and second-stage compression
+     Hap compressor/format constants can be unpacked by reading the top and bottom four bits.
+     */
+    texture->textureFormat = hap_texture_format_constant_for_format_identifier(hap_bottom_4_bits(texture_section_type));
+    if (texture->textureFormat == 0)
+    {
+        return HapResult_Bad_Frame;
+    }
+
+    texture->section = texture_section;
+    texture->sectionBytes = texture_section_length;
+    texture->sectionCompressor = hap_top_4_bits(texture_section_type);
+    texture->chunkCompressors = NULL;
+    texture->chunkSizes = NULL;
+    texture->chunkOffsets = NULL;
+    texture->chunkData = texture_section;
+
+    if (texture->sectionCompressor == kHapCompressorComplex)
+    {
+        HapDecodeInstructions instructions;
+
+        result = hap_read_decode_instructions(texture_section, texture_section_length, &instructions);
+        if (result != HapResult_No_Error)
+        {
+            return result;
         }
-        memcpy(outputBuffer, texture_section, texture_section_length);
+
+        texture->chunkCount = instructions.chunk_count;
+        texture->chunkCompressors = instructions.compressors;
+        texture->chunkSizes = instructions.chunk_sizes;
+        texture->chunkOffsets = instructions.chunk_offsets;
+        texture->chunkData = instructions.frame_data;
+    }
+    else if (texture->sectionCompressor == kHapCompressorSnappy || texture->sectionCompressor == kHapCompressorNone)
+    {
+        texture->chunkCount = 1;
     }
     else
     {
         return HapResult_Bad_Frame;
     }
+
+    /*
+     Step through the chunks, verifying each lies within the section and totalling their lengths
+     */
+    for (i = 0; i < texture->chunkCount; i++)
+    {
+        unsigned int compressor;
+        const char *data;
+        size_t length;
+        size_t uncompressed_length;
+        size_t offset;
+
+        hap_read_texture_chunk(texture, i, running_compressed_length, &compressor, &data, &length);
+
+        offset = data - (const char *)texture_section;
+        if (data < (const char *)texture_section || offset > texture_section_length || length > texture_section_length - offset)
+        {
+            return HapResult_Bad_Frame;
+        }
+
+        result = hap_chunk_uncompressed_length(compressor, data, length, &uncompressed_length);
+        if (result != HapResult_No_Error)
+        {
+            return result;
+        }
+
+        /*
+         The texture can only be used in place if every chunk is uncompressed and each follows the previous
+         */
+        if (compressor != kHapCompressorNone || data != ((const char *)texture->chunkData) + running_compressed_length)
+        {
+            contiguous = 0;
+        }
+
+        running_compressed_length += length;
+        running_uncompressed_length += uncompressed_length;
+    }
+
+    texture->compressedBytes = running_compressed_length;
+    texture->uncompressedBytes = running_uncompressed_length;
+    texture->uncompressedData = contiguous ? texture->chunkData : NULL;
+
+    return HapResult_No_Error;
+}
+
+/*
+ The storage needed to decode a texture, beyond the one chunk we can track on the stack
+ */
+static size_t hap_decode_scratch_length(const HapTextureDescriptor *texture)
+{
+    return texture->chunkCount > 1 ? sizeof(HapChunkDecodeInfo) * texture->chunkCount : 0;
+}
+
+/*
+ Decodes a parsed texture, tracking its chunks in scratch if it has more than one
+ */
+static int hap_decode_texture(const HapTextureDescriptor *texture,
+                              HapDecodeCallback callback, void *info,
+                              HapChunkDecodeInfo *scratch,
+                              void *outputBuffer, unsigned long outputBufferBytes,
+                              unsigned long *outputBufferBytesUsed)
+{
+    int result = HapResult_No_Error;
+
+    if (texture->uncompressedBytes > outputBufferBytes)
+    {
+        return HapResult_Buffer_Too_Small;
+    }
+
+    if (texture->chunkCount > 0)
+    {
+        /*
+         Step through the chunks, storing information for their decompression
+         */
+        HapChunkDecodeInfo single_chunk_info;
+        HapChunkDecodeInfo *chunk_info = texture->chunkCount > 1 ? scratch : &single_chunk_info;
+        size_t running_compressed_chunk_size = 0;
+        size_t running_uncompressed_chunk_size = 0;
+        unsigned int i;
+
+        for (i = 0; i < texture->chunkCount; i++)
+        {
+            /*
+             The chunks were checked by hap_parse_texture(), so this can't fail
+             */
+            hap_read_texture_chunk(texture, i, running_compressed_chunk_size,
+                                   &chunk_info[i].compressor,
+                                   &chunk_info[i].compressed_chunk_data,
+                                   &chunk_info[i].compressed_chunk_size);
+            hap_chunk_uncompressed_length(chunk_info[i].compressor,
+                                          chunk_info[i].compressed_chunk_data,
+                                          chunk_info[i].compressed_chunk_size,
+                                          &chunk_info[i].uncompressed_chunk_size);
+
+            chunk_info[i].uncompressed_chunk_data = (char *)(((uint8_t *)outputBuffer) + running_uncompressed_chunk_size);
+
+            running_compressed_chunk_size += chunk_info[i].compressed_chunk_size;
+            running_uncompressed_chunk_size += chunk_info[i].uncompressed_chunk_size;
+        }
+
+        /*
+         Perform decompression
+         */
+        if (texture->chunkCount == 1 || callback == NULL)
+        {
+            /*
+             We don't invoke the callback for one chunk, just decode it directly
+             */
+            for (i = 0; i < texture->chunkCount; i++)
+            {
+                hap_decode_chunk(chunk_info, i);
+            }
+        }
+        else
+        {
+            callback((HapDecodeWorkFunction)hap_decode_chunk, chunk_info, texture->chunkCount, info);
+        }
+
+        /*
+         Check to see if we encountered any errors and report one of them
+         */
+        for (i = 0; i < texture->chunkCount; i++)
+        {
+            if (chunk_info[i].result != HapResult_No_Error)
+            {
+                result = chunk_info[i].result;
+                break;
+            }
+        }
+
+        if (result != HapResult_No_Error)
+        {
+            return result;
+        }
+    }
+
     /*
      Fill out the remaining return value
      */
     if (outputBufferBytesUsed != NULL)
     {
-        *outputBufferBytesUsed = bytesUsed;
+        *outputBufferBytesUsed = texture->uncompressedBytes;
     }
-    
+
     return HapResult_No_Error;
 }
 
+/*
+ Decodes a parsed texture, allocating any scratch it needs
+ */
+static int hap_decode_texture_allocating(const HapTextureDescriptor *texture,
+                                         HapDecodeCallback callback, void *info,
+                                         void *outputBuffer, unsigned long outputBufferBytes,
+                                         unsigned long *outputBufferBytesUsed)
+{
+    int result;
+    HapChunkDecodeInfo *scratch = NULL;
+    size_t scratch_length = hap_decode_scratch_length(texture);
+
+    if (scratch_length > 0)
+    {
+        scratch = (HapChunkDecodeInfo *)malloc(scratch_length);
+        if (scratch == NULL)
+        {
+            return HapResult_Internal_Error;
+        }
+    }
+
+    result = hap_decode_texture(texture, callback, info, scratch, outputBuffer, outputBufferBytes, outputBufferBytesUsed);
+
+    free(scratch);
+
+    return result;
+}
+
+unsigned int hap_decode_single_texture(const void *texture_section, uint32_t texture_section_length,
+                                       unsigned int texture_section_type,
+                                       HapDecodeCallback callback, void *info,
+                                       void *outputBuffer, unsigned long outputBufferBytes,
+                                       unsigned long *outputBufferBytesUsed,
+                                       unsigned int *outputBufferTextureFormat)
+{
+    HapTextureDescriptor texture;
+    int result;
+
+    /*
+     Pass the texture format out
+     */
+    *outputBufferTextureFormat = hap_texture_format_constant_for_format_identifier(hap_bottom_4_bits(texture_section_type));
+
+    result = hap_parse_texture(texture_section, texture_section_length, texture_section_type, &texture);
+    if (result != HapResult_No_Error)
+    {
+        return result;
+    }
+
+    return hap_decode_texture_allocating(&texture, callback, info, outputBuffer, outputBufferBytes, outputBufferBytesUsed);
+}
+
 int hap_get_section_at_index(const void *input_buffer, uint32_t input_buffer_bytes,
                              unsigned int index,
                              const void **section, uint32_t *section_length, unsigned int *section_type)
@@ -1082,3 +1486,256 @@ unsigned int HapGetFrameTextureFormat(const void *inputBuffer, unsigned long inp
     }
     return result;
 }
+
+unsigned int HapGetFrameTextureInfo(const void *inputBuffer, unsigned long inputBufferBytes, unsigned int index, unsigned int *outputTextureFormat, unsigned int *outputChunkCount)
+{
+    int result;
+    uint32_t section_header_length;
+    uint32_t section_length;
+    unsigned int section_type;
+    unsigned long offset = 0;
+
+    if (inputBuffer == NULL || outputTextureFormat == NULL || outputChunkCount == NULL)
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    result = hap_read_section_header_only(inputBuffer, inputBufferBytes, &section_header_length, &section_length, &section_type);
+    if (result != HapResult_No_Error)
+    {
+        return result;
+    }
+
+    if (section_type == kHapSectionMultipleImages)
+    {
+        /*
+         Step through until we find the section at index, which requires every earlier texture to be present
+         */
+        unsigned long top_section_end = section_header_length + section_length;
+        unsigned int i;
+        offset = section_header_length;
+        for (i = 0; i <= index; i++)
+        {
+            if (offset >= top_section_end)
+            {
+                return HapResult_Bad_Arguments;
+            }
+            if (offset >= inputBufferBytes)
+            {
+                return HapResult_Buffer_Too_Small;
+            }
+            result = hap_read_section_header_only(((uint8_t *)inputBuffer) + offset, inputBufferBytes - offset,
+                                                  &section_header_length, &section_length, &section_type);
+            if (result != HapResult_No_Error)
+            {
+                return result;
+            }
+            if (i < index)
+            {
+                offset += section_header_length + section_length;
+            }
+        }
+    }
+    else if (index != 0)
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    *outputTextureFormat = hap_texture_format_constant_for_format_identifier(hap_bottom_4_bits(section_type));
+    if (*outputTextureFormat == 0)
+    {
+        return HapResult_Bad_Frame;
+    }
+
+    if (hap_top_4_bits(section_type) == kHapCompressorComplex)
+    {
+        /*
+         The Decode Instructions Container is at the start of the section, and must be present in full
+         */
+        const void *section = ((uint8_t *)inputBuffer) + offset + section_header_length;
+        unsigned long bytes_available = inputBufferBytes - offset - section_header_length;
+        uint32_t container_header_length;
+        uint32_t container_length;
+        unsigned int container_type;
+        HapDecodeInstructions instructions;
+
+        result = hap_read_section_header_only(section, (bytes_available < section_length ? bytes_available : section_length), &container_header_length, &container_length, &container_type);
+        if (result != HapResult_No_Error)
+        {
+            return section_length < bytes_available ? HapResult_Bad_Frame : result;
+        }
+        if (container_header_length + container_length > bytes_available)
+        {
+            return HapResult_Buffer_Too_Small;
+        }
+        result = hap_read_decode_instructions(section, container_header_length + container_length, &instructions);
+        if (result != HapResult_No_Error)
+        {
+            return result;
+        }
+        *outputChunkCount = instructions.chunk_count;
+    }
+    else
+    {
+        *outputChunkCount = 1;
+    }
+
+    return HapResult_No_Error;
+}
+
+unsigned int HapParseFrame(const void *inputBuffer, unsigned long inputBufferBytes, HapFrameDescriptor *outputDescriptor)
+{
+    int result;
+    uint32_t section_header_length;
+    uint32_t section_length;
+    unsigned int section_type;
+
+    if (inputBuffer == NULL || outputDescriptor == NULL)
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    outputDescriptor->textureCount = 0;
+
+    result = hap_read_section_header(inputBuffer, inputBufferBytes, &section_header_length, &section_length, &section_type);
+    if (result != HapResult_No_Error)
+    {
+        return result;
+    }
+
+    if (section_type == kHapSectionMultipleImages)
+    {
+        /*
+         Step through the sections inside the top-level section, parsing each texture
+         */
+        const uint8_t *section_start = ((const uint8_t *)inputBuffer) + section_header_length;
+        uint32_t bytes_remaining = section_length;
+        while (bytes_remaining > 0)
+        {
+            if (outputDescriptor->textureCount == 2)
+            {
+                return HapResult_Bad_Frame;
+            }
+            result = hap_read_section_header(section_start, bytes_remaining, &section_header_length, &section_length, &section_type);
+            if (result == HapResult_No_Error)
+            {
+                result = hap_parse_texture(section_start + section_header_length, section_length, section_type,
+                                           &outputDescriptor->textures[outputDescriptor->textureCount]);
+            }
+            if (result != HapResult_No_Error)
+            {
+                outputDescriptor->textureCount = 0;
+                return result;
+            }
+            outputDescriptor->textureCount++;
+            section_start += section_header_length + section_length;
+            bytes_remaining -= section_header_length + section_length;
+        }
+        if (outputDescriptor->textureCount == 0)
+        {
+            return HapResult_Bad_Frame;
+        }
+    }
+    else
+    {
+        /*
+         A single-texture frame with the texture as the top section.
+         */
+        result = hap_parse_texture(((const uint8_t *)inputBuffer) + section_header_length, section_length, section_type,
+                                   &outputDescriptor->textures[0]);
+        if (result != HapResult_No_Error)
+        {
+            return result;
+        }
+        outputDescriptor->textureCount = 1;
+    }
+
+    return HapResult_No_Error;
+}
+
+unsigned int HapGetTextureChunks(const HapFrameDescriptor *descriptor, unsigned int index, HapChunkDescriptor *outputChunks, unsigned int outputChunksCount)
+{
+    const HapTextureDescriptor *texture;
+    size_t running_compressed_length = 0;
+    size_t running_uncompressed_length = 0;
+    unsigned int i;
+
+    if (descriptor == NULL || index >= descriptor->textureCount || outputChunks == NULL)
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    texture = &descriptor->textures[index];
+
+    if (outputChunksCount < texture->chunkCount)
+    {
+        return HapResult_Buffer_Too_Small;
+    }
+
+    for (i = 0; i < texture->chunkCount; i++)
+    {
+        unsigned int compressor;
+        const char *data;
+        size_t length;
+        size_t uncompressed_length = 0;
+
+        /*
+         The chunks were checked by HapParseFrame(), so this can't fail
+         */
+        hap_read_texture_chunk(texture, i, running_compressed_length, &compressor, &data, &length);
+        hap_chunk_uncompressed_length(compressor, data, length, &uncompressed_length);
+
+        outputChunks[i].compressor = compressor == kHapCompressorSnappy ? HapCompressorSnappy : HapCompressorNone;
+        outputChunks[i].data = data;
+        outputChunks[i].compressedBytes = length;
+        outputChunks[i].uncompressedOffset = running_uncompressed_length;
+        outputChunks[i].uncompressedBytes = uncompressed_length;
+
+        running_compressed_length += length;
+        running_uncompressed_length += uncompressed_length;
+    }
+
+    return HapResult_No_Error;
+}
+
+unsigned int HapDecodeTexture(const HapFrameDescriptor *descriptor, unsigned int index,
+                              HapDecodeCallback callback, void *info,
+                              void *outputBuffer, unsigned long outputBufferBytes,
+                              unsigned long *outputBufferBytesUsed)
+{
+    if (descriptor == NULL || index >= descriptor->textureCount || outputBuffer == NULL)
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    return hap_decode_texture_allocating(&descriptor->textures[index], callback, info, outputBuffer, outputBufferBytes, outputBufferBytesUsed);
+}
+
+unsigned long HapDecodeScratchLength(const HapFrameDescriptor *descriptor, unsigned int index)
+{
+    if (descriptor == NULL || index >= descriptor->textureCount)
+    {
+        return 0;
+    }
+
+    return hap_decode_scratch_length(&descriptor->textures[index]);
+}
+
+unsigned int HapDecodeTextureWithScratch(const HapFrameDescriptor *descriptor, unsigned int index,
+                                         HapDecodeCallback callback, void *info,
+                                         void *scratch, unsigned long scratchBytes,
+                                         void *outputBuffer, unsigned long outputBufferBytes,
+                                         unsigned long *outputBufferBytesUsed)
+{
+    if (descriptor == NULL || index >= descriptor->textureCount || outputBuffer == NULL)
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    if (scratchBytes < hap_decode_scratch_length(&descriptor->textures[index]))
+    {
+        return HapResult_Buffer_Too_Small;
+    }
+
+    return hap_decode_texture(&descriptor->textures[index], callback, info, (HapChunkDecodeInfo *)scratch, outputBuffer, outputBufferBytes, outputBufferBytesUsed);
+}
@@ -63,6 +63,12 @@ enum HapResult {
 typedef void (*HapDecodeWorkFunction)(void *p, unsigned int index);
 typedef void (*HapDecodeCallback)(HapDecodeWorkFunction function, void *p, unsigned int count, void *info);
 
+/*
+ See HapEncode for descriptions of these function types.
+ */
+typedef void (*HapEncodeWorkFunction)(void *p, unsigned int index);
+typedef void (*HapEncodeCallback)(HapEncodeWorkFunction function, void *p, unsigned int count, void *info);
+
 /*
  Returns the maximum size of an output buffer for a frame composed of one or more textures, or returns 0 on error.
  count is the number of textures (1 or 2) and matches the number of values in the array arguments
@@ -88,6 +94,8 @@ unsigned long HapMaxEncodedLength(unsigned int count,
  textureFormats is an array of HapTextureFormats
  compressors is an array of HapCompressors
  chunkCounts is an array of chunk counts to permit multithreaded decoding (1 or more)
+ callback and info permit multithreaded compression of chunks, and work as described for HapDecode. If callback is NULL,
+ chunks are compressed one after another on the calling thread. The encoded frame is the same either way.
  outputBuffer is the destination buffer to receive the encoded frame
  outputBufferBytes is the destination buffer's length in bytes
  outputBufferBytesUsed will be set to the actual encoded length of the frame on return
@@ -97,9 +105,73 @@ unsigned int HapEncode(unsigned int count,
                        unsigned int *textureFormats,
                        unsigned int *compressors,
                        unsigned int *chunkCounts,
+                       HapEncodeCallback callback, void *info,
                        void *outputBuffer, unsigned long outputBufferBytes,
                        unsigned long *outputBufferBytesUsed);
 
+/*
+ The greatest number of chunks a texture may be divided into
+ */
+#define HapMaxChunkCount 3355431
+
+/*
+ Returns the number of chunks HapEncode() divides a texture of inputBytes into when chunkCount chunks are requested:
+ the greatest count no more than chunkCount and HapMaxChunkCount which divides the texture equally on DXT block
+ boundaries.
+ */
+unsigned int HapLimitedChunkCount(unsigned long inputBytes, unsigned int textureFormat, unsigned int chunkCount);
+
+/*
+ Streaming encoding writes a frame of one texture a chunk at a time, so the whole encoded frame need never be in memory.
+ The frame starts with a header written by HapEncodeStreamHeader(), followed by the chunks in order, each compressed with
+ HapEncodeChunk(). Write the header first with the chunk details omitted to reserve its place, then write it again in
+ the same place once every chunk is known. With the chunk count from HapLimitedChunkCount() and chunks of equal length,
+ the frame is identical to one from HapEncode(). Frames are limited to 4 GB.
+ */
+
+/*
+ Returns the length of the header HapEncodeStreamHeader() writes for a texture of inputBufferBytes in chunkCount chunks,
+ or 0 if the arguments aren't permitted. The header written once the chunks are known may be shorter, but never longer.
+ */
+unsigned long HapStreamHeaderLength(unsigned long inputBufferBytes, unsigned int chunkCount);
+
+/*
+ Writes the header of a streamed frame to outputBuffer, which must be at least HapStreamHeaderLength() bytes.
+ inputBufferBytes is the length of the whole texture.
+ chunkCompressors and chunkSizes are arrays of chunkCount values set by HapEncodeChunk(). Either may be NULL if their
+ values aren't yet known, in which case zeroes are written in their place. Returns HapResult_Bad_Arguments if the frame
+ would exceed 4 GB.
+ outputBufferBytesUsed will be set to the length of the header.
+ If outputCompressor is not NULL and the chunks save no space over the uncompressed texture, it is set to
+ HapCompressorNone and the header is that of a frame storing the texture uncompressed: HapEncode() would store the
+ texture that way, and to match it the header must be followed by the whole texture in place of the chunks. Otherwise
+ outputCompressor is set to HapCompressorSnappy. If outputCompressor is NULL the chunks are always used.
+ */
+unsigned int HapEncodeStreamHeader(unsigned long inputBufferBytes, unsigned int textureFormat, unsigned int chunkCount,
+                                   const unsigned int *chunkCompressors,
+                                   const unsigned long *chunkSizes,
+                                   void *outputBuffer, unsigned long outputBufferBytes,
+                                   unsigned long *outputBufferBytesUsed,
+                                   unsigned int *outputCompressor);
+
+/*
+ Returns the minimal value of outputBufferBytes for HapEncodeChunk() to compress a chunk of inputBufferBytes
+ */
+unsigned long HapMaxEncodedChunkLength(unsigned long inputBufferBytes);
+
+/*
+ Compresses one chunk of a streamed frame. Chunks should divide the texture on DXT block boundaries.
+ compressor is a HapCompressor. outputCompressor is set to the HapCompressor the chunk is stored with, and
+ outputBufferBytesUsed to its stored length. If compression saves no space outputCompressor is set to HapCompressorNone,
+ nothing is written to outputBuffer and inputBuffer is to be stored as the chunk. outputBuffer may be NULL if
+ compressor is HapCompressorNone.
+ */
+unsigned int HapEncodeChunk(const void *inputBuffer, unsigned long inputBufferBytes,
+                            unsigned int compressor,
+                            void *outputBuffer, unsigned long outputBufferBytes,
+                            unsigned long *outputBufferBytesUsed,
+                            unsigned int *outputCompressor);
+
 /*
  Decodes a texture from inputBuffer which is a Hap frame.
 
@@ -143,6 +215,98 @@ unsigned int HapGetFrameTextureCount(const void *inputBuffer, unsigned long inpu
  */
 unsigned int HapGetFrameTextureFormat(const void *inputBuffer, unsigned long inputBufferBytes, unsigned int index, unsigned int *outputBufferTextureFormat);
 
+/*
+ Reads the format and chunk count of the texture at index from the start of a frame, without requiring the whole frame.
+ inputBuffer must contain at least the headers of the frame and the texture, and the texture's decode instructions,
+ otherwise this returns HapResult_Buffer_Too_Small, and the call may be repeated with more of the frame.
+ On success sets outputTextureFormat to a HapTextureFormat constant and outputChunkCount to the number of chunks the
+ texture is divided into, which is 1 if it isn't divided.
+ */
+unsigned int HapGetFrameTextureInfo(const void *inputBuffer, unsigned long inputBufferBytes, unsigned int index, unsigned int *outputTextureFormat, unsigned int *outputChunkCount);
+
+/*
+ The textures of a frame as found by HapParseFrame(). The pointers refer to memory within the parsed frame, which must
+ remain valid and unchanged while the descriptor is used.
+ */
+typedef struct HapTextureDescriptor {
+    /* A HapTextureFormat constant */
+    unsigned int textureFormat;
+    /* The number of chunks the texture is divided into, which is 1 if it isn't divided */
+    unsigned int chunkCount;
+    /* The total length in bytes of the texture's chunks as stored */
+    unsigned long compressedBytes;
+    /* The length in bytes of the decoded texture */
+    unsigned long uncompressedBytes;
+    /* The texture data if it is stored without second-stage compression in one contiguous block, otherwise NULL */
+    const void *uncompressedData;
+    /* The remaining fields are for use by the functions below */
+    const void *section;
+    unsigned long sectionBytes;
+    unsigned int sectionCompressor;
+    const void *chunkCompressors;
+    const void *chunkSizes;
+    const void *chunkOffsets;
+    const void *chunkData;
+} HapTextureDescriptor;
+
+typedef struct HapFrameDescriptor {
+    /* The number of textures in the frame (1 or 2) and in textures */
+    unsigned int textureCount;
+    HapTextureDescriptor textures[2];
+} HapFrameDescriptor;
+
+typedef struct HapChunkDescriptor {
+    /* A HapCompressor constant */
+    unsigned int compressor;
+    /* The stored chunk within the frame */
+    const void *data;
+    unsigned long compressedBytes;
+    /* The position and length in bytes of the decoded chunk within the decoded texture */
+    unsigned long uncompressedOffset;
+    unsigned long uncompressedBytes;
+} HapChunkDescriptor;
+
+/*
+ Parses the headers and chunk tables of every texture in a frame once, so its textures can be inspected and decoded
+ without parsing it again. On success fills outputDescriptor and returns HapResult_No_Error. This validates that every
+ chunk lies within the frame, but not the chunks' contents.
+ */
+unsigned int HapParseFrame(const void *inputBuffer, unsigned long inputBufferBytes, HapFrameDescriptor *outputDescriptor);
+
+/*
+ Describes the chunks of the texture at index in a parsed frame. outputChunks must have room for at least the texture's
+ chunkCount entries, and outputChunksCount is its capacity.
+ */
+unsigned int HapGetTextureChunks(const HapFrameDescriptor *descriptor, unsigned int index, HapChunkDescriptor *outputChunks, unsigned int outputChunksCount);
+
+/*
+ Decodes the texture at index from a frame parsed with HapParseFrame(). Otherwise works as HapDecode(), except that if
+ callback is NULL the chunks are decoded one after another on the calling thread. The texture's format is found in the
+ descriptor. outputBufferBytes must be at least the texture's uncompressedBytes.
+ */
+unsigned int HapDecodeTexture(const HapFrameDescriptor *descriptor, unsigned int index,
+                              HapDecodeCallback callback, void *info,
+                              void *outputBuffer, unsigned long outputBufferBytes,
+                              unsigned long *outputBufferBytesUsed);
+
+/*
+ Returns the length in bytes of the scratch HapDecodeTextureWithScratch() needs to decode the texture at index in a
+ parsed frame, which is 0 if it needs none.
+ */
+unsigned long HapDecodeScratchLength(const HapFrameDescriptor *descriptor, unsigned int index);
+
+/*
+ As HapDecodeTexture() but never allocates memory. scratch is used to track the texture's chunks while they are decoded,
+ and must be at least HapDecodeScratchLength() bytes, aligned as memory returned by malloc(), and used by no other
+ decode at the same time. It may be NULL if HapDecodeScratchLength() is 0. Returns HapResult_Buffer_Too_Small if
+ scratchBytes is too small.
+ */
+unsigned int HapDecodeTextureWithScratch(const HapFrameDescriptor *descriptor, unsigned int index,
+                                         HapDecodeCallback callback, void *info,
+                                         void *scratch, unsigned long scratchBytes,
+                                         void *outputBuffer, unsigned long outputBufferBytes,
+                                         unsigned long *outputBufferBytesUsed);
+
 #ifdef __cplusplus
 }
 #endif
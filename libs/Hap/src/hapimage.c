@@ -79,14 +79,17 @@ static void hapimage_write_4_byte_uint(const void *buffer, unsigned int value)
 
 #define hapimage_bottom_4_bits(x) ((x) & 0x0F)
 
-static int hapimage_read_section_header(const void *buffer, uint32_t buffer_length, uint32_t *out_header_length, uint32_t *out_section_length, unsigned int *out_section_type)
+/*
+ Reads a section header without requiring the rest of the section to be in the buffer
+ */
+static int hapimage_read_section_header_only(const void *buffer, uint32_t buffer_length, uint32_t *out_header_length, uint32_t *out_section_length, unsigned int *out_section_type)
 {
     /*
      Verify buffer is big enough to contain a four-byte header
      */
     if (buffer_length < 4U)
     {
-        return HapImageResult_Bad_Image;
+        return HapImageResult_Buffer_Too_Small;
     }
 
     /*
@@ -105,7 +108,7 @@ static int hapimage_read_section_header(const void *buffer, uint32_t buffer_leng
          */
         if (buffer_length < 8U)
         {
-            return HapImageResult_Bad_Image;
+            return HapImageResult_Buffer_Too_Small;
         }
         *out_section_length = hapimage_read_4_byte_uint(((uint8_t *)buffer) + 4U);
         *out_header_length = 8U;
@@ -119,7 +122,18 @@ static int hapimage_read_section_header(const void *buffer, uint32_t buffer_leng
      The fourth byte stores the section type
      */
     *out_section_type = *(((uint8_t *)buffer) + 3U);
-    
+
+    return HapImageResult_No_Error;
+}
+
+static int hapimage_read_section_header(const void *buffer, uint32_t buffer_length, uint32_t *out_header_length, uint32_t *out_section_length, unsigned int *out_section_type)
+{
+    int result = hapimage_read_section_header_only(buffer, buffer_length, out_header_length, out_section_length, out_section_type);
+    if (result != HapImageResult_No_Error)
+    {
+        return HapImageResult_Bad_Image;
+    }
+
     /*
      Verify the section does not extend beyond the buffer
      */
@@ -212,6 +226,73 @@ unsigned int HapImageRead(const void *inputBuffer, unsigned long inputBufferByte
     return HapImageResult_No_Error;
 }
 
+unsigned int HapImageReadHeader(const void *inputBuffer, unsigned long inputBufferBytes,
+                                unsigned int *width, unsigned int *height,
+                                unsigned long *frameOffset, unsigned long *frameBytes)
+{
+    const uint8_t *start = inputBuffer;
+    const void *dimensions = NULL;
+    int found_frame = 0;
+    if (inputBuffer == NULL || width == NULL || height == NULL || frameOffset == NULL || frameBytes == NULL)
+    {
+        return HapImageResult_Bad_Arguments;
+    }
+    if (inputBufferBytes < 4U)
+    {
+        return HapImageResult_Buffer_Too_Small;
+    }
+    {
+        // Check for the Hap Image signature
+        if (start[0] != 0x88 || start[1] != 0x48 || start[2] != 0x61 || start[3] != 0x70)
+        {
+            return HapImageResult_Bad_Image;
+        }
+        inputBuffer = start + 4;
+        inputBufferBytes -= 4;
+    }
+    do {
+        // Parse sections following the signature. Only the header of the frame section need be present.
+        uint32_t section_header_length;
+        uint32_t section_length;
+        unsigned int section_type;
+        int result = hapimage_read_section_header_only(inputBuffer, inputBufferBytes, &section_header_length, &section_length, &section_type);
+        if (result != HapImageResult_No_Error)
+        {
+            return result;
+        }
+        if (section_type == kHapSectionDimensions)
+        {
+            if (section_header_length + 8U > inputBufferBytes)
+            {
+                return HapImageResult_Buffer_Too_Small;
+            }
+            dimensions = ((uint8_t *)inputBuffer) + section_header_length;
+        }
+        else if (hapimage_is_top_level_section(section_type))
+        {
+            *frameOffset = (unsigned long)((const uint8_t *)inputBuffer - start);
+            *frameBytes = section_header_length + section_length;
+            found_frame = 1;
+        }
+        if (dimensions == NULL || found_frame == 0)
+        {
+            if (section_header_length + section_length > inputBufferBytes)
+            {
+                return HapImageResult_Buffer_Too_Small;
+            }
+            inputBuffer = ((uint8_t *)inputBuffer) + section_header_length + section_length;
+            inputBufferBytes -= section_header_length + section_length;
+        }
+    } while ((found_frame == 0 || dimensions == NULL) && inputBufferBytes > 0);
+    if (!dimensions || !found_frame)
+    {
+        return HapImageResult_Buffer_Too_Small;
+    }
+    *width = hapimage_read_4_byte_uint(dimensions);
+    *height = hapimage_read_4_byte_uint(((uint8_t *)dimensions) + 4);
+    return HapImageResult_No_Error;
+}
+
 unsigned int HapImageWrite(unsigned int width, unsigned int height,
                            void *outputBuffer, unsigned long outputBufferBytes,
                            unsigned long *outputBufferBytesUsed)
@@ -52,6 +52,17 @@ enum HapImageResult {
 unsigned int HapImageRead(const void *inputBuffer, unsigned long inputBufferBytes,
                           unsigned int *width, unsigned int *height,
                           const void **frame, unsigned long *frameBytes);
+/*
+ Parses a Hap Image header from the start of a file without requiring the whole file, and on success sets width, height,
+ frameOffset and frameBytes and returns HapImageResult_No_Error. frameOffset is the position of the frame from the start of
+ the file, and frameBytes is the length of the frame. The dimensions, the header of the frame and any sections between them
+ must be present in inputBuffer, otherwise returns HapImageResult_Buffer_Too_Small, and the call may be repeated with more
+ of the file.
+ */
+unsigned int HapImageReadHeader(const void *inputBuffer, unsigned long inputBufferBytes,
+                                unsigned int *width, unsigned int *height,
+                                unsigned long *frameOffset, unsigned long *frameBytes);
+
 /*
  Generates a Hap Image header in outputBuffer and returns HapResult_No_Error on success.
  When saving a Hap Image file the generated header must be immediately followed by a frame created with HapEncode() from hap.h.
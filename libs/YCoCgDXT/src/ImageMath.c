@@ -43,8 +43,477 @@
 #include <Accelerate/Accelerate.h>
 #endif
 
+#if !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IMAGE_MATH_USE_SSE2
+#include <emmintrin.h>
+#if defined(_MSC_VER)
+#define IMAGE_MATH_USE_AVX2
+#define IMAGE_MATH_TARGET_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#elif defined(__GNUC__) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define IMAGE_MATH_USE_AVX2
+#define IMAGE_MATH_TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#endif
+#elif defined(IMAGE_MATH_ENABLE_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64))
+/*
+ The NEON path is opt-in: define IMAGE_MATH_ENABLE_NEON to use it, otherwise ARM builds use the scalar path
+ */
+#define IMAGE_MATH_USE_NEON
+#include <arm_neon.h>
+#endif
+#endif
+
 #define CLAMP_UINT8( x ) ( (x) < 0 ? (0) : ( (x) > 255 ? 255 : (x) ) )
 
+#if !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
+static void image_math_matrix_multiply_pixels(const uint8_t *pixel_src,
+                                              uint8_t *pixel_dst,
+                                              unsigned long count,
+                                              const int16_t matrix[4*4],
+                                              int32_t divisor,
+                                              const int16_t *pre_bias,
+                                              const int32_t *post_bias)
+{
+    unsigned long x;
+    for (x = 0; x < count; x++) {
+        
+        int32_t result[4];
+        int32_t source[4] = { pixel_src[0], pixel_src[1], pixel_src[2], pixel_src[3] };
+        
+        // Pre-bias
+        if (pre_bias != NULL)
+        {
+            source[0] += pre_bias[0];
+            source[1] += pre_bias[1];
+            source[2] += pre_bias[2];
+            source[3] += pre_bias[3];
+        }
+        
+        // MM
+        result[0] = (matrix[0] * source[0]) + (matrix[4] * source[1]) + (matrix[8]  * source[2]) + (matrix[12] * source[3]);
+        result[1] = (matrix[1] * source[0]) + (matrix[5] * source[1]) + (matrix[9]  * source[2]) + (matrix[13] * source[3]);
+        result[2] = (matrix[2] * source[0]) + (matrix[6] * source[1]) + (matrix[10] * source[2]) + (matrix[14] * source[3]);
+        result[3] = (matrix[3] * source[0]) + (matrix[7] * source[1]) + (matrix[11] * source[2]) + (matrix[15] * source[3]);
+        
+        // Post-bias
+        if (post_bias != NULL)
+        {
+            result[0] += post_bias[0];
+            result[1] += post_bias[1];
+            result[2] += post_bias[2];
+            result[3] += post_bias[3];
+        }
+        
+        // Divisor
+        result[0] /= divisor;
+        result[1] /= divisor;
+        result[2] /= divisor;
+        result[3] /= divisor;
+        
+        // Clamp
+        pixel_dst[0] = CLAMP_UINT8(result[0]);
+        pixel_dst[1] = CLAMP_UINT8(result[1]);
+        pixel_dst[2] = CLAMP_UINT8(result[2]);
+        pixel_dst[3] = CLAMP_UINT8(result[3]);
+
+        pixel_src += 4;
+        pixel_dst += 4;
+    }
+}
+#endif // !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
+
+#if defined(IMAGE_MATH_USE_SSE2) || defined(IMAGE_MATH_USE_NEON)
+/*
+ The vector paths produce exactly the same results as the scalar path. They work on 16-bit biased source values and
+ replace the division with a shift, so they are only used when the biased values fit in 16 bits and the divisor is a
+ power of two.
+ */
+typedef struct ImageMathMatrixKernel {
+    int16_t matrix[4*4];
+    int16_t pre_bias[4];
+    int32_t post_bias[4];
+    int shift;
+} ImageMathMatrixKernel;
+
+static int image_math_matrix_kernel_init(ImageMathMatrixKernel *kernel,
+                                         const int16_t matrix[4*4],
+                                         int32_t divisor,
+                                         const int16_t *pre_bias,
+                                         const int32_t *post_bias)
+{
+    int i;
+    if (divisor <= 0 || (divisor & (divisor - 1)) != 0)
+    {
+        return 0;
+    }
+    for (kernel->shift = 0; (1 << kernel->shift) != divisor; kernel->shift++);
+    for (i = 0; i < 4; i++)
+    {
+        kernel->pre_bias[i] = (pre_bias != NULL ? pre_bias[i] : 0);
+        kernel->post_bias[i] = (post_bias != NULL ? post_bias[i] : 0);
+        if (kernel->pre_bias[i] > INT16_MAX - 255)
+        {
+            return 0;
+        }
+    }
+    for (i = 0; i < 16; i++)
+    {
+        // A product of two -32768s would overflow the SSE2 pairwise multiply-add
+        if (matrix[i] == INT16_MIN)
+        {
+            return 0;
+        }
+        kernel->matrix[i] = matrix[i];
+    }
+    return 1;
+}
+#endif // defined(IMAGE_MATH_USE_SSE2) || defined(IMAGE_MATH_USE_NEON)
+
+#ifdef IMAGE_MATH_USE_SSE2
+/*
+ Each 32-bit lane of a multiplier holds the matrix entries for two source channels, so _mm_madd_epi16 on pairs of source
+ channels gives half the sum for one destination channel.
+ */
+static int32_t image_math_pair(int16_t a, int16_t b)
+{
+    return (int32_t)(((uint32_t)(uint16_t)b << 16) | (uint16_t)a);
+}
+
+static unsigned long image_math_matrix_multiply_row_sse2(const uint8_t *pixel_src,
+                                                         uint8_t *pixel_dst,
+                                                         unsigned long width,
+                                                         const ImageMathMatrixKernel *kernel)
+{
+    unsigned long x;
+    int c;
+    __m128i m01[4], m23[4], post[4];
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pre = _mm_setr_epi16(kernel->pre_bias[0], kernel->pre_bias[1], kernel->pre_bias[2], kernel->pre_bias[3],
+                                       kernel->pre_bias[0], kernel->pre_bias[1], kernel->pre_bias[2], kernel->pre_bias[3]);
+    const __m128i round = _mm_set1_epi32((1 << kernel->shift) - 1);
+    const __m128i shift = _mm_cvtsi32_si128(kernel->shift);
+    for (c = 0; c < 4; c++)
+    {
+        m01[c] = _mm_set1_epi32(image_math_pair(kernel->matrix[c], kernel->matrix[4 + c]));
+        m23[c] = _mm_set1_epi32(image_math_pair(kernel->matrix[8 + c], kernel->matrix[12 + c]));
+        post[c] = _mm_set1_epi32(kernel->post_bias[c]);
+    }
+    for (x = 0; x + 4 <= width; x += 4) {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(pixel_src + (x * 4)));
+        // Widen to 16 bits, two pixels per register, and bias
+        __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(pixels, zero), pre);
+        __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(pixels, zero), pre);
+        // Gather channels 0 and 1 of all four pixels, then channels 2 and 3
+        __m128i s01, s23, result[4], packed;
+        lo = _mm_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+        hi = _mm_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+        s01 = _mm_unpacklo_epi64(lo, hi);
+        s23 = _mm_unpackhi_epi64(lo, hi);
+        for (c = 0; c < 4; c++)
+        {
+            __m128i sum = _mm_add_epi32(_mm_madd_epi16(s01, m01[c]), _mm_madd_epi16(s23, m23[c]));
+            sum = _mm_add_epi32(sum, post[c]);
+            // Division rounding towards zero, as in C
+            sum = _mm_add_epi32(sum, _mm_and_si128(_mm_srai_epi32(sum, 31), round));
+            result[c] = _mm_sra_epi32(sum, shift);
+        }
+        // Saturating packs clamp to 0...255, leaving the channels in the order 0, 2, 1, 3 for each group of four pixels
+        packed = _mm_packus_epi16(_mm_packs_epi32(result[0], result[2]), _mm_packs_epi32(result[1], result[3]));
+        // Interleave the channels back into pixels
+        packed = _mm_unpacklo_epi8(packed, _mm_srli_si128(packed, 8));
+        packed = _mm_unpacklo_epi16(packed, _mm_srli_si128(packed, 8));
+        _mm_storeu_si128((__m128i *)(pixel_dst + (x * 4)), packed);
+    }
+    return x;
+}
+#endif // IMAGE_MATH_USE_SSE2
+
+#ifdef IMAGE_MATH_USE_AVX2
+static int image_math_has_avx2(void)
+{
+    static int has_avx2 = -1;
+    if (has_avx2 == -1)
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        int result = 0;
+        __cpuid(info, 0);
+        if (info[0] >= 7)
+        {
+            __cpuid(info, 1);
+            // The OS must save the AVX registers
+            if ((info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 6) == 6)
+            {
+                __cpuidex(info, 7, 0);
+                result = (info[1] & (1 << 5)) != 0;
+            }
+        }
+        has_avx2 = result;
+#else
+        has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+#endif
+    }
+    return has_avx2;
+}
+
+/*
+ The same as the SSE2 path, eight pixels at a time. Every operation works within 128-bit lanes, so each lane holds four
+ pixels exactly as an SSE2 register does.
+ */
+IMAGE_MATH_TARGET_AVX2 static unsigned long image_math_matrix_multiply_row_avx2(const uint8_t *pixel_src,
+                                                                                uint8_t *pixel_dst,
+                                                                                unsigned long width,
+                                                                                const ImageMathMatrixKernel *kernel)
+{
+    unsigned long x;
+    int c;
+    __m256i m01[4], m23[4], post[4];
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i pre = _mm256_setr_epi16(kernel->pre_bias[0], kernel->pre_bias[1], kernel->pre_bias[2], kernel->pre_bias[3],
+                                          kernel->pre_bias[0], kernel->pre_bias[1], kernel->pre_bias[2], kernel->pre_bias[3],
+                                          kernel->pre_bias[0], kernel->pre_bias[1], kernel->pre_bias[2], kernel->pre_bias[3],
+                                          kernel->pre_bias[0], kernel->pre_bias[1], kernel->pre_bias[2], kernel->pre_bias[3]);
+    const __m256i round = _mm256_set1_epi32((1 << kernel->shift) - 1);
+    const __m128i shift = _mm_cvtsi32_si128(kernel->shift);
+    for (c = 0; c < 4; c++)
+    {
+        m01[c] = _mm256_set1_epi32(image_math_pair(kernel->matrix[c], kernel->matrix[4 + c]));
+        m23[c] = _mm256_set1_epi32(image_math_pair(kernel->matrix[8 + c], kernel->matrix[12 + c]));
+        post[c] = _mm256_set1_epi32(kernel->post_bias[c]);
+    }
+    for (x = 0; x + 8 <= width; x += 8) {
+        __m256i pixels = _mm256_loadu_si256((const __m256i *)(pixel_src + (x * 4)));
+        __m256i lo = _mm256_add_epi16(_mm256_unpacklo_epi8(pixels, zero), pre);
+        __m256i hi = _mm256_add_epi16(_mm256_unpackhi_epi8(pixels, zero), pre);
+        __m256i s01, s23, result[4], packed;
+        lo = _mm256_shuffle_epi32(lo, _MM_SHUFFLE(3, 1, 2, 0));
+        hi = _mm256_shuffle_epi32(hi, _MM_SHUFFLE(3, 1, 2, 0));
+        s01 = _mm256_unpacklo_epi64(lo, hi);
+        s23 = _mm256_unpackhi_epi64(lo, hi);
+        for (c = 0; c < 4; c++)
+        {
+            __m256i sum = _mm256_add_epi32(_mm256_madd_epi16(s01, m01[c]), _mm256_madd_epi16(s23, m23[c]));
+            sum = _mm256_add_epi32(sum, post[c]);
+            sum = _mm256_add_epi32(sum, _mm256_and_si256(_mm256_srai_epi32(sum, 31), round));
+            result[c] = _mm256_sra_epi32(sum, shift);
+        }
+        packed = _mm256_packus_epi16(_mm256_packs_epi32(result[0], result[2]), _mm256_packs_epi32(result[1], result[3]));
+        packed = _mm256_unpacklo_epi8(packed, _mm256_srli_si256(packed, 8));
+        packed = _mm256_unpacklo_epi16(packed, _mm256_srli_si256(packed, 8));
+        _mm256_storeu_si256((__m256i *)(pixel_dst + (x * 4)), packed);
+    }
+    return x;
+}
+#endif // IMAGE_MATH_USE_AVX2
+
+#ifdef IMAGE_MATH_USE_NEON
+static unsigned long image_math_matrix_multiply_row_neon(const uint8_t *pixel_src,
+                                                         uint8_t *pixel_dst,
+                                                         unsigned long width,
+                                                         const ImageMathMatrixKernel *kernel)
+{
+    unsigned long x;
+    int c, k;
+    const int32x4_t round = vdupq_n_s32((1 << kernel->shift) - 1);
+    const int32x4_t shift = vdupq_n_s32(-kernel->shift);
+    for (x = 0; x + 8 <= width; x += 8) {
+        // Load eight pixels with their channels separated
+        uint8x8x4_t pixels = vld4_u8(pixel_src + (x * 4));
+        uint8x8x4_t output;
+        int16x8_t source[4];
+        for (k = 0; k < 4; k++)
+        {
+            source[k] = vaddq_s16(vreinterpretq_s16_u16(vmovl_u8(pixels.val[k])), vdupq_n_s16(kernel->pre_bias[k]));
+        }
+        for (c = 0; c < 4; c++)
+        {
+            int32x4_t sum_lo = vmull_n_s16(vget_low_s16(source[0]), kernel->matrix[c]);
+            int32x4_t sum_hi = vmull_n_s16(vget_high_s16(source[0]), kernel->matrix[c]);
+            for (k = 1; k < 4; k++)
+            {
+                sum_lo = vmlal_n_s16(sum_lo, vget_low_s16(source[k]), kernel->matrix[(k * 4) + c]);
+                sum_hi = vmlal_n_s16(sum_hi, vget_high_s16(source[k]), kernel->matrix[(k * 4) + c]);
+            }
+            sum_lo = vaddq_s32(sum_lo, vdupq_n_s32(kernel->post_bias[c]));
+            sum_hi = vaddq_s32(sum_hi, vdupq_n_s32(kernel->post_bias[c]));
+            // Division rounding towards zero, as in C
+            sum_lo = vaddq_s32(sum_lo, vandq_s32(vshrq_n_s32(sum_lo, 31), round));
+            sum_hi = vaddq_s32(sum_hi, vandq_s32(vshrq_n_s32(sum_hi, 31), round));
+            sum_lo = vshlq_s32(sum_lo, shift);
+            sum_hi = vshlq_s32(sum_hi, shift);
+            // Saturating narrows clamp to 0...255
+            output.val[c] = vqmovun_s16(vcombine_s16(vqmovn_s32(sum_lo), vqmovn_s32(sum_hi)));
+        }
+        vst4_u8(pixel_dst + (x * 4), output);
+    }
+    return x;
+}
+#endif // IMAGE_MATH_USE_NEON
+
+#if !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
+static ImageMathInstructions image_math_instruction_limit = ImageMathInstructions_AVX2;
+static ImageMathTileCallback image_math_tile_callback = NULL;
+static void *image_math_tile_info = NULL;
+
+/*
+ Operations on at least this many pixels are divided into bands of rows, each of at least this many pixels
+ */
+#define kImageMathMinimumTilePixels 65536
+
+/*
+ The parts of an operation common to every band of rows
+ */
+typedef struct ImageMathOperation {
+    const uint8_t *src;
+    size_t src_bytes_per_row;
+    uint8_t *dst;
+    size_t dst_bytes_per_row;
+    unsigned long width;
+    unsigned long height;
+    unsigned int tile_count;
+    const int16_t *matrix;
+    int32_t divisor;
+    const int16_t *pre_bias;
+    const int32_t *post_bias;
+#if defined(IMAGE_MATH_USE_SSE2) || defined(IMAGE_MATH_USE_NEON)
+    ImageMathMatrixKernel kernel;
+    int use_vector;
+#endif
+#ifdef IMAGE_MATH_USE_AVX2
+    int use_avx2;
+#endif
+    const uint8_t *permute_map;
+} ImageMathOperation;
+
+static unsigned int image_math_tile_count(unsigned long width, unsigned long height, int allow_tile)
+{
+    unsigned long count;
+    if (allow_tile == 0 || image_math_tile_callback == NULL)
+    {
+        return 1;
+    }
+    count = (width * height) / kImageMathMinimumTilePixels;
+    if (count > height)
+    {
+        count = height;
+    }
+    return count > 1 ? (unsigned int)count : 1;
+}
+
+static void image_math_perform(void (*function)(void *p, unsigned int index), ImageMathOperation *operation)
+{
+    if (operation->tile_count > 1)
+    {
+        image_math_tile_callback(function, operation, operation->tile_count, image_math_tile_info);
+    }
+    else
+    {
+        function(operation, 0);
+    }
+}
+
+static void image_math_matrix_multiply_tile(void *p, unsigned int index)
+{
+    const ImageMathOperation *operation = (const ImageMathOperation *)p;
+    unsigned long y = (operation->height * index) / operation->tile_count;
+    unsigned long end = (operation->height * (index + 1)) / operation->tile_count;
+    const uint8_t *pixel_src = operation->src + (y * operation->src_bytes_per_row);
+    uint8_t *pixel_dst = operation->dst + (y * operation->dst_bytes_per_row);
+    unsigned long width = operation->width;
+
+    for (; y < end; y++) {
+        unsigned long done = 0;
+#if defined(IMAGE_MATH_USE_AVX2)
+        if (operation->use_avx2)
+        {
+            done = image_math_matrix_multiply_row_avx2(pixel_src, pixel_dst, width, &operation->kernel);
+        }
+#endif
+#if defined(IMAGE_MATH_USE_SSE2)
+        if (operation->use_vector)
+        {
+            done += image_math_matrix_multiply_row_sse2(pixel_src + (done * 4), pixel_dst + (done * 4), width - done, &operation->kernel);
+        }
+#elif defined(IMAGE_MATH_USE_NEON)
+        if (operation->use_vector)
+        {
+            done = image_math_matrix_multiply_row_neon(pixel_src, pixel_dst, width, &operation->kernel);
+        }
+#endif
+        // The scalar path finishes any pixels left over
+        image_math_matrix_multiply_pixels(pixel_src + (done * 4), pixel_dst + (done * 4), width - done,
+                                          operation->matrix, operation->divisor, operation->pre_bias, operation->post_bias);
+        pixel_src += operation->src_bytes_per_row;
+        pixel_dst += operation->dst_bytes_per_row;
+    }
+}
+
+static void image_math_permute_tile(void *p, unsigned int index)
+{
+    const ImageMathOperation *operation = (const ImageMathOperation *)p;
+    unsigned long y = (operation->height * index) / operation->tile_count;
+    unsigned long end = (operation->height * (index + 1)) / operation->tile_count;
+    unsigned long x;
+    int i;
+    const uint8_t *pixel_src = operation->src + (y * operation->src_bytes_per_row);
+    uint8_t *pixel_dst = operation->dst + (y * operation->dst_bytes_per_row);
+    size_t src_bytes_extra_per_row = operation->src_bytes_per_row - (operation->width * 4);
+    size_t dst_bytes_extra_per_row = operation->dst_bytes_per_row - (operation->width * 4);
+    for (; y < end; y++) {
+        for (x = 0; x < operation->width; x++) {
+            for(i = 0; i < 4; i++ ) {
+                pixel_dst[i] = pixel_src[operation->permute_map[i]];
+            }
+            pixel_src += 4;
+            pixel_dst += 4;
+        }
+        pixel_src += src_bytes_extra_per_row;
+        pixel_dst += dst_bytes_extra_per_row;
+    }
+}
+#endif // !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
+
+void ImageMath_SetTileCallback(ImageMathTileCallback callback, void *info)
+{
+#if !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
+    image_math_tile_callback = callback;
+    image_math_tile_info = info;
+#else
+    (void)callback;
+    (void)info;
+#endif
+}
+
+void ImageMath_SetInstructionLimit(ImageMathInstructions limit)
+{
+#if !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
+    image_math_instruction_limit = limit;
+#else
+    (void)limit;
+#endif
+}
+
+ImageMathInstructions ImageMath_GetInstructions(void)
+{
+    ImageMathInstructions result = ImageMathInstructions_Scalar;
+#if defined(IMAGE_MATH_USE_SSE2) || defined(IMAGE_MATH_USE_NEON)
+    if (image_math_instruction_limit >= ImageMathInstructions_Vector)
+    {
+        result = ImageMathInstructions_Vector;
+    }
+#endif
+#ifdef IMAGE_MATH_USE_AVX2
+    if (image_math_instruction_limit >= ImageMathInstructions_AVX2 && image_math_has_avx2())
+    {
+        result = ImageMathInstructions_AVX2;
+    }
+#endif
+    return result;
+}
+
 void ImageMath_MatrixMultiply8888(const void *src,
                                   size_t src_bytes_per_row,
                                   void *dst,
@@ -90,60 +559,27 @@ void ImageMath_MatrixMultiply8888(const void *src,
     {
 #endif // IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED
 #if !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
-        unsigned long y, x;
-        const uint8_t *pixel_src = (const uint8_t *)src;
-        uint8_t *pixel_dst = (uint8_t *)dst;
-        size_t src_bytes_extra_per_row = src_bytes_per_row - (width * 4);
-        size_t dst_bytes_extra_per_row = dst_bytes_per_row - (width * 4);
-
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                
-                int32_t result[4];
-                int32_t source[4] = { pixel_src[0], pixel_src[1], pixel_src[2], pixel_src[3] };
-                
-                // Pre-bias
-                if (pre_bias != NULL)
-                {
-                    source[0] += pre_bias[0];
-                    source[1] += pre_bias[1];
-                    source[2] += pre_bias[2];
-                    source[3] += pre_bias[3];
-                }
-                
-                // MM
-                result[0] = (matrix[0] * source[0]) + (matrix[4] * source[1]) + (matrix[8]  * source[2]) + (matrix[12] * source[3]);
-                result[1] = (matrix[1] * source[0]) + (matrix[5] * source[1]) + (matrix[9]  * source[2]) + (matrix[13] * source[3]);
-                result[2] = (matrix[2] * source[0]) + (matrix[6] * source[1]) + (matrix[10] * source[2]) + (matrix[14] * source[3]);
-                result[3] = (matrix[3] * source[0]) + (matrix[7] * source[1]) + (matrix[11] * source[2]) + (matrix[15] * source[3]);
-                
-                // Post-bias
-                if (post_bias != NULL)
-                {
-                    result[0] += post_bias[0];
-                    result[1] += post_bias[1];
-                    result[2] += post_bias[2];
-                    result[3] += post_bias[3];
-                }
-                
-                // Divisor
-                result[0] /= divisor;
-                result[1] /= divisor;
-                result[2] /= divisor;
-                result[3] /= divisor;
-                
-                // Clamp
-                pixel_dst[0] = CLAMP_UINT8(result[0]);
-                pixel_dst[1] = CLAMP_UINT8(result[1]);
-                pixel_dst[2] = CLAMP_UINT8(result[2]);
-                pixel_dst[3] = CLAMP_UINT8(result[3]);
-
-                pixel_src += 4;
-                pixel_dst += 4;
-            }
-            pixel_src += src_bytes_extra_per_row;
-            pixel_dst += dst_bytes_extra_per_row;
-        }
+        ImageMathOperation operation;
+        operation.src = (const uint8_t *)src;
+        operation.src_bytes_per_row = src_bytes_per_row;
+        operation.dst = (uint8_t *)dst;
+        operation.dst_bytes_per_row = dst_bytes_per_row;
+        operation.width = width;
+        operation.height = height;
+        operation.tile_count = image_math_tile_count(width, height, allow_tile);
+        operation.matrix = matrix;
+        operation.divisor = divisor;
+        operation.pre_bias = pre_bias;
+        operation.post_bias = post_bias;
+#if defined(IMAGE_MATH_USE_SSE2) || defined(IMAGE_MATH_USE_NEON)
+        operation.use_vector = image_math_instruction_limit >= ImageMathInstructions_Vector &&
+                               image_math_matrix_kernel_init(&operation.kernel, matrix, divisor, pre_bias, post_bias);
+#endif
+#ifdef IMAGE_MATH_USE_AVX2
+        operation.use_avx2 = operation.use_vector && image_math_instruction_limit >= ImageMathInstructions_AVX2 && image_math_has_avx2();
+#endif
+        operation.permute_map = NULL;
+        image_math_perform(image_math_matrix_multiply_tile, &operation);
 #endif // !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
 #ifdef IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED
     }
@@ -186,23 +622,16 @@ void ImageMath_Permute8888(const void *src,
     {
 #endif // IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED
 #if !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
-        unsigned long y, x;
-        int i;
-        const uint8_t *pixel_src = (const uint8_t *)src;
-        uint8_t *pixel_dst = (uint8_t *)dst;
-        size_t src_bytes_extra_per_row = src_bytes_per_row - (width * 4);
-        size_t dst_bytes_extra_per_row = dst_bytes_per_row - (width * 4);
-        for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++) {
-                for(i = 0; i < 4; i++ ) {
-                    pixel_dst[i] = pixel_src[permuteMap[i]];
-                }
-                pixel_src += 4;
-                pixel_dst += 4;
-            }
-            pixel_src += src_bytes_extra_per_row;
-            pixel_dst += dst_bytes_extra_per_row;
-        }
+        ImageMathOperation operation;
+        operation.src = (const uint8_t *)src;
+        operation.src_bytes_per_row = src_bytes_per_row;
+        operation.dst = (uint8_t *)dst;
+        operation.dst_bytes_per_row = dst_bytes_per_row;
+        operation.width = width;
+        operation.height = height;
+        operation.tile_count = image_math_tile_count(width, height, allow_tile);
+        operation.permute_map = permuteMap;
+        image_math_perform(image_math_permute_tile, &operation);
 #endif // !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
 #ifdef IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED
     }
@@ -33,6 +33,41 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ Where vImage isn't used, operations permitted to tile are divided into bands of rows, and the callback set here is used
+ to perform the bands on a number of threads. It works like the HapDecodeCallback in hap.h: call function once for each
+ index from 0 to count - 1, usually from several threads, and don't return until every call has completed.
+ info is passed to the callback unchanged. Pass NULL for callback to perform all operations on the calling thread, which
+ is the default. The results are the same either way.
+ Set the callback before performing any operations rather than while they are in progress.
+ */
+typedef void (*ImageMathWorkFunction)(void *p, unsigned int index);
+typedef void (*ImageMathTileCallback)(ImageMathWorkFunction function, void *p, unsigned int count, void *info);
+
+void ImageMath_SetTileCallback(ImageMathTileCallback callback, void *info);
+
+/*
+ Where vImage isn't used, limits the instructions ImageMath_MatrixMultiply8888() uses, so the paths can be compared.
+ The results are the same for any limit. ImageMathInstructions_Vector is SSE2, or NEON where IMAGE_MATH_ENABLE_NEON is
+ defined. The default, ImageMathInstructions_AVX2, uses the best the machine has.
+ ImageMath_GetInstructions() returns what is used under the current limit on this machine, for matrices the vector
+ paths support.
+ Set the limit before performing any operations rather than while they are in progress.
+ */
+typedef enum ImageMathInstructions {
+    ImageMathInstructions_Scalar = 0,
+    ImageMathInstructions_Vector = 1,
+    ImageMathInstructions_AVX2 = 2
+} ImageMathInstructions;
+
+void ImageMath_SetInstructionLimit(ImageMathInstructions limit);
+
+ImageMathInstructions ImageMath_GetInstructions(void);
+
 void ImageMath_MatrixMultiply8888(const void *src,
                                   size_t src_bytes_per_row,
                                   void *dst,
@@ -54,4 +89,8 @@ void ImageMath_Permute8888(const void *src,
                            const uint8_t permuteMap[4], // positions are dst channel order, values are src channel order
                            int allow_tile); // if non-zero, operation may be tiled and multithreaded
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -72,6 +72,16 @@
 #include "YCoCgDXT.h"
 #include <string.h>
 #include <stdlib.h>
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define YCOCG_DXT_USE_SSE2
+#elif defined(YCOCG_DXT_ENABLE_NEON) && (defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64))
+/*
+ The NEON paths are opt-in: define YCOCG_DXT_ENABLE_NEON to use them, otherwise ARM builds use the scalar paths
+ */
+#include <arm_neon.h>
+#define YCOCG_DXT_USE_NEON
+#endif
 
 /* ALWAYS_INLINE */
 /* Derived from EAWebKit's AlwaysInline.h, losing some of its support for other compilers */
@@ -127,7 +137,7 @@ typedef unsigned int    dword;
 
 #define NVIDIA_G7X_HARDWARE_BUG_FIX     // keep the colors sorted as: max, min
 
-#if defined(__LITTLE_ENDIAN__) || defined(_WIN32)
+#if defined(__LITTLE_ENDIAN__) || defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
 #define EA_SYSTEM_LITTLE_ENDIAN
 #endif
 
@@ -164,14 +174,14 @@ static ALWAYS_INLINE void ExtractBlock( const byte *inPtr, const int stride, byt
 // This box extract replicates the last rows and columns if the row or columns are not 4 texels aligned
 // This is so we don't get random pixels which could affect the color interpolation
 static void ExtractBlock( const byte *inPtr, const int stride, const int widthRemain, const int heightRemain, byte *colorBlock ) {
-    int *pBlock32 = (int *) colorBlock;  // Since we are using ARGA, we assume 4 byte alignment is already being used
-    int *pSource32 = (int*) inPtr; 
+    // Texels are copied a byte at a time, so neither the source nor its stride need be 4 byte aligned
+    const byte *pSource = inPtr; 
     
     int hIndex=0;
     for(int j =0; j < 4; j++) {
         int wIndex = 0;
         for(int i=0; i < 4; i++) {
-            pBlock32[i] = pSource32[wIndex];    
+            memcpy( colorBlock + ( i * 4 ), pSource + ( wIndex * 4 ), 4 );
             // Set up offset for next column source (keep existing if we are at the end)         
             if(wIndex < (widthRemain - 1)) {
                 wIndex++;
@@ -179,15 +189,80 @@ static void ExtractBlock( const byte *inPtr, const int stride, const int widthRe
         }
         
         // Set up offset for next texel row source (keep existing if we are at the end)
-        pBlock32 +=4;    
+        colorBlock += 16;    
         if(hIndex < (heightRemain-1)) {
-            pSource32 +=(stride >> 2);
+            pSource += stride;
             hIndex++;
         }
     }
 }
 
-static void GetMinMaxYCoCg( byte *colorBlock, byte *minColor, byte *maxColor ) {
+// Swaps the first and third channels of a block, converting BGRA texels to RGBA
+static ALWAYS_INLINE void SwapBlockRedBlue( byte *colorBlock ) {
+#if defined(YCOCG_DXT_USE_SSE2)
+    const __m128i green_alpha = _mm_set1_epi32( (int)0xFF00FF00 );
+    const __m128i mask = _mm_set1_epi32( 0xFF );
+    for ( int i = 0; i < 4; i++ ) {
+        __m128i texels = _mm_loadu_si128( (const __m128i *)( colorBlock + ( i * 16 ) ) );
+        __m128i red = _mm_and_si128( _mm_srli_epi32( texels, 16 ), mask );
+        __m128i blue = _mm_slli_epi32( _mm_and_si128( texels, mask ), 16 );
+        texels = _mm_or_si128( _mm_and_si128( texels, green_alpha ), _mm_or_si128( red, blue ) );
+        _mm_storeu_si128( (__m128i *)( colorBlock + ( i * 16 ) ), texels );
+    }
+#elif defined(YCOCG_DXT_USE_NEON)
+    const uint32x4_t green_alpha = vdupq_n_u32( 0xFF00FF00 );
+    const uint32x4_t mask = vdupq_n_u32( 0xFF );
+    for ( int i = 0; i < 4; i++ ) {
+        uint32x4_t texels = vreinterpretq_u32_u8( vld1q_u8( colorBlock + ( i * 16 ) ) );
+        uint32x4_t red = vandq_u32( vshrq_n_u32( texels, 16 ), mask );
+        uint32x4_t blue = vshlq_n_u32( vandq_u32( texels, mask ), 16 );
+        texels = vorrq_u32( vandq_u32( texels, green_alpha ), vorrq_u32( red, blue ) );
+        vst1q_u8( colorBlock + ( i * 16 ), vreinterpretq_u8_u32( texels ) );
+    }
+#else
+    for ( int i = 0; i < 16; i++ ) {
+        byte b = colorBlock[i*4+0];
+        colorBlock[i*4+0] = colorBlock[i*4+2];
+        colorBlock[i*4+2] = b;
+    }
+#endif
+}
+
+// Converts a block of RGBA texels to CoCg_Y in place. This is the same integer arithmetic as ConvertRGB_ToCoCg_Y8888()
+// and gives the same results: every sum is non-negative and in range, so the divisions are shifts without clamping.
+static ALWAYS_INLINE void ConvertBlockRGBAToCoCg_Y( byte *colorBlock ) {
+#ifdef YCOCG_DXT_USE_SSE2
+    // Four texels at a time in 32-bit lanes
+    const __m128i mask = _mm_set1_epi32( 0xFF );
+    const __m128i bias = _mm_set1_epi32( 512 );
+    for ( int i = 0; i < 4; i++ ) {
+        __m128i texels = _mm_loadu_si128( (const __m128i *)( colorBlock + ( i * 16 ) ) );
+        __m128i r = _mm_and_si128( texels, mask );
+        __m128i g2 = _mm_slli_epi32( _mm_and_si128( _mm_srli_epi32( texels, 8 ), mask ), 1 );
+        __m128i b = _mm_and_si128( _mm_srli_epi32( texels, 16 ), mask );
+        __m128i a = _mm_srli_epi32( texels, 24 );
+        __m128i rb = _mm_add_epi32( r, b );
+        __m128i co = _mm_srli_epi32( _mm_add_epi32( _mm_slli_epi32( _mm_sub_epi32( r, b ), 1 ), bias ), 2 );
+        __m128i cg = _mm_srli_epi32( _mm_add_epi32( _mm_sub_epi32( g2, rb ), bias ), 2 );
+        __m128i y = _mm_srli_epi32( _mm_add_epi32( rb, g2 ), 2 );
+        texels = _mm_or_si128( _mm_or_si128( co, _mm_slli_epi32( cg, 8 ) ),
+                               _mm_or_si128( _mm_slli_epi32( a, 16 ), _mm_slli_epi32( y, 24 ) ) );
+        _mm_storeu_si128( (__m128i *)( colorBlock + ( i * 16 ) ), texels );
+    }
+#else
+    for ( int i = 0; i < 16; i++ ) {
+        int r = colorBlock[i*4+0];
+        int g = colorBlock[i*4+1];
+        int b = colorBlock[i*4+2];
+        colorBlock[i*4+0] = (byte)( ( ( r - b ) * 2 + 512 ) >> 2 );
+        colorBlock[i*4+1] = (byte)( ( ( g * 2 ) - r - b + 512 ) >> 2 );
+        // The alpha channel is left where it is
+        colorBlock[i*4+3] = (byte)( ( r + ( g * 2 ) + b ) >> 2 );
+    }
+#endif
+}
+
+static ALWAYS_INLINE void GetMinMaxYCoCg( byte *colorBlock, byte *minColor, byte *maxColor ) {
     minColor[0] = minColor[1] = minColor[2] = minColor[3] = 255;
     maxColor[0] = maxColor[1] = maxColor[2] = maxColor[3] = 0;
     
@@ -230,7 +305,8 @@ static ALWAYS_INLINE int absEA( int liArg )
 }
 
 
-static void ScaleYCoCg( byte *colorBlock, byte *minColor, byte *maxColor ) {
+// Scales the chroma bounds and returns the scale to apply to the block
+static ALWAYS_INLINE int ScaleYCoCgBounds( byte *minColor, byte *maxColor ) {
     int m0 = absEA( minColor[0] - 128 );      // (the 128 is to center to color to grey (128,128) )
     int m1 = absEA( minColor[1] - 128 );
     int m2 = absEA( maxColor[0] - 128 );
@@ -255,13 +331,19 @@ static void ScaleYCoCg( byte *colorBlock, byte *minColor, byte *maxColor ) {
     maxColor[1] = ( maxColor[1] - 128 ) * scale + 128;
     maxColor[2] = ( scale - 1 ) << 3;
     
+    return scale;
+}
+
+static ALWAYS_INLINE void ScaleYCoCg( byte *colorBlock, byte *minColor, byte *maxColor ) {
+    int scale = ScaleYCoCgBounds( minColor, maxColor );
+    
     for ( int i = 0; i < 16; i++ ) {
         colorBlock[i*4+0] = ( colorBlock[i*4+0] - 128 ) * scale + 128;
         colorBlock[i*4+1] = ( colorBlock[i*4+1] - 128 ) * scale + 128;
     }
 }
 
-static void InsetYCoCgBBox( byte *minColor, byte *maxColor ) {
+static ALWAYS_INLINE void InsetYCoCgBBox( byte *minColor, byte *maxColor ) {
     int inset[4];
     int mini[4];
     int maxi[4];
@@ -295,17 +377,8 @@ static void InsetYCoCgBBox( byte *minColor, byte *maxColor ) {
     maxColor[3] = maxi[3];
 }
 
-static void SelectYCoCgDiagonal( const byte *colorBlock, byte *minColor, byte *maxColor ) {
-    byte mid0 = ( (int) minColor[0] + maxColor[0] + 1 ) >> 1;
-    byte mid1 = ( (int) minColor[1] + maxColor[1] + 1 ) >> 1;
-    
-    byte side = 0;
-    for ( int i = 0; i < 16; i++ ) {
-        byte b0 = colorBlock[i*4+0] >= mid0;
-        byte b1 = colorBlock[i*4+1] >= mid1;
-        side += ( b0 ^ b1 );
-    }
-    
+// side is the number of texels on the opposite diagonal of the bounds to the one they describe
+static ALWAYS_INLINE void SwapYCoCgDiagonal( const byte side, byte *minColor, byte *maxColor ) {
     byte mask = -( side > 8 );
     
 #ifdef NVIDIA_G7X_HARDWARE_BUG_FIX
@@ -325,36 +398,38 @@ static void SelectYCoCgDiagonal( const byte *colorBlock, byte *minColor, byte *m
     maxColor[1] = c1;
 }
 
-static void EmitAlphaIndices( const byte *colorBlock, const byte minAlpha, const byte maxAlpha, byte **outData ) {
-        
-    const int ALPHA_RANGE = 7;
+static ALWAYS_INLINE void SelectYCoCgDiagonal( const byte *colorBlock, byte *minColor, byte *maxColor ) {
+    byte mid0 = ( (int) minColor[0] + maxColor[0] + 1 ) >> 1;
+    byte mid1 = ( (int) minColor[1] + maxColor[1] + 1 ) >> 1;
     
-    byte mid, ab1, ab2, ab3, ab4, ab5, ab6, ab7;
-    byte indexes[16];
+    byte side = 0;
+    for ( int i = 0; i < 16; i++ ) {
+        byte b0 = colorBlock[i*4+0] >= mid0;
+        byte b1 = colorBlock[i*4+1] >= mid1;
+        side += ( b0 ^ b1 );
+    }
     
-    mid = ( maxAlpha - minAlpha ) / ( 2 * ALPHA_RANGE );
+    SwapYCoCgDiagonal( side, minColor, maxColor );
+}
+
+// Sets ab[0] to ab[6] to the thresholds between the eight alpha values
+static ALWAYS_INLINE void GetAlphaThresholds( const byte minAlpha, const byte maxAlpha, byte *ab ) {
     
-    ab1 = minAlpha + mid;
-    ab2 = ( 6 * maxAlpha + 1 * minAlpha ) / ALPHA_RANGE + mid;
-    ab3 = ( 5 * maxAlpha + 2 * minAlpha ) / ALPHA_RANGE + mid;
-    ab4 = ( 4 * maxAlpha + 3 * minAlpha ) / ALPHA_RANGE + mid;
-    ab5 = ( 3 * maxAlpha + 4 * minAlpha ) / ALPHA_RANGE + mid;
-    ab6 = ( 2 * maxAlpha + 5 * minAlpha ) / ALPHA_RANGE + mid;
-    ab7 = ( 1 * maxAlpha + 6 * minAlpha ) / ALPHA_RANGE + mid;
+    const int ALPHA_RANGE = 7;
     
-    for ( int i = 0; i < 16; i++ ) {
-        byte a = colorBlock[i*4+3]; // Here it seems to be using the Y (luna) for the alpha
-        int b1 = ( a <= ab1 );
-        int b2 = ( a <= ab2 );
-        int b3 = ( a <= ab3 );
-        int b4 = ( a <= ab4 );
-        int b5 = ( a <= ab5 );
-        int b6 = ( a <= ab6 );
-        int b7 = ( a <= ab7 );
-        int index = ( b1 + b2 + b3 + b4 + b5 + b6 + b7 + 1 ) & 7;
-        indexes[i] = index ^ ( 2 > index );
-    }
+    byte mid = ( maxAlpha - minAlpha ) / ( 2 * ALPHA_RANGE );
     
+    ab[0] = minAlpha + mid;
+    ab[1] = ( 6 * maxAlpha + 1 * minAlpha ) / ALPHA_RANGE + mid;
+    ab[2] = ( 5 * maxAlpha + 2 * minAlpha ) / ALPHA_RANGE + mid;
+    ab[3] = ( 4 * maxAlpha + 3 * minAlpha ) / ALPHA_RANGE + mid;
+    ab[4] = ( 3 * maxAlpha + 4 * minAlpha ) / ALPHA_RANGE + mid;
+    ab[5] = ( 2 * maxAlpha + 5 * minAlpha ) / ALPHA_RANGE + mid;
+    ab[6] = ( 1 * maxAlpha + 6 * minAlpha ) / ALPHA_RANGE + mid;
+}
+
+// Packs sixteen 3-bit alpha indices into 6 bytes
+static ALWAYS_INLINE void EmitPackedAlphaIndices( const byte *indexes, byte **outData ) {
     EmitByte( (indexes[ 0] >> 0) | (indexes[ 1] << 3) | (indexes[ 2] << 6),  outData );
     EmitByte( (indexes[ 2] >> 2) | (indexes[ 3] << 1) | (indexes[ 4] << 4) | (indexes[ 5] << 7), outData );
     EmitByte( (indexes[ 5] >> 1) | (indexes[ 6] << 2) | (indexes[ 7] << 5), outData );
@@ -364,10 +439,34 @@ static void EmitAlphaIndices( const byte *colorBlock, const byte minAlpha, const
     EmitByte( (indexes[13] >> 1) | (indexes[14] << 2) | (indexes[15] << 5), outData );
 }
 
-static void EmitColorIndices( const byte *colorBlock, const byte *minColor, const byte *maxColor, byte **outData ) {
-    word colors[4][4];
-    unsigned int result = 0;
+static ALWAYS_INLINE byte GetAlphaIndex( const byte a, const byte *ab ) {
+    int b1 = ( a <= ab[0] );
+    int b2 = ( a <= ab[1] );
+    int b3 = ( a <= ab[2] );
+    int b4 = ( a <= ab[3] );
+    int b5 = ( a <= ab[4] );
+    int b6 = ( a <= ab[5] );
+    int b7 = ( a <= ab[6] );
+    int index = ( b1 + b2 + b3 + b4 + b5 + b6 + b7 + 1 ) & 7;
+    return index ^ ( 2 > index );
+}
+
+static ALWAYS_INLINE void EmitAlphaIndices( const byte *colorBlock, const byte minAlpha, const byte maxAlpha, byte **outData ) {
+    
+    byte ab[7];
+    byte indexes[16];
     
+    GetAlphaThresholds( minAlpha, maxAlpha, ab );
+    
+    for ( int i = 0; i < 16; i++ ) {
+        indexes[i] = GetAlphaIndex( colorBlock[i*4+3], ab ); // Here it seems to be using the Y (luna) for the alpha
+    }
+    
+    EmitPackedAlphaIndices( indexes, outData );
+}
+
+// Sets colors to the four colors the block's indices choose between
+static ALWAYS_INLINE void GetColorPalette( const byte *minColor, const byte *maxColor, word colors[4][4] ) {
     colors[0][0] = ( maxColor[0] & C565_5_MASK ) | ( maxColor[0] >> 5 );
     colors[0][1] = ( maxColor[1] & C565_6_MASK ) | ( maxColor[1] >> 6 );
     colors[0][2] = ( maxColor[2] & C565_5_MASK ) | ( maxColor[2] >> 5 );
@@ -384,17 +483,141 @@ static void EmitColorIndices( const byte *colorBlock, const byte *minColor, cons
     colors[3][1] = ( 1 * colors[0][1] + 2 * colors[1][1] ) / 3;
     colors[3][2] = ( 1 * colors[0][2] + 2 * colors[1][2] ) / 3;
     colors[3][3] = 0;
+}
+
+static ALWAYS_INLINE int GetCoCgIndex( const int c0, const int c1, word colors[4][4] ) {
+    int d0 = absEA( colors[0][0] - c0 ) + absEA( colors[0][1] - c1 );
+    int d1 = absEA( colors[1][0] - c0 ) + absEA( colors[1][1] - c1 );
+    int d2 = absEA( colors[2][0] - c0 ) + absEA( colors[2][1] - c1 );
+    int d3 = absEA( colors[3][0] - c0 ) + absEA( colors[3][1] - c1 );
+    
+    bool b0 = d0 > d3;
+    bool b1 = d1 > d2;
+    bool b2 = d0 > d2;
+    bool b3 = d1 > d3;
+    bool b4 = d2 > d3;
+    
+    int x0 = b1 & b2;
+    int x1 = b0 & b3;
+    int x2 = b0 & b4;
+    
+    return x2 | ( ( x0 | x1 ) << 1 );
+}
+
+static ALWAYS_INLINE void EmitColorIndices( const byte *colorBlock, const byte *minColor, const byte *maxColor, byte **outData ) {
+    word colors[4][4];
+    unsigned int result = 0;
+    
+    GetColorPalette( minColor, maxColor, colors );
     
     for ( int i = 15; i >= 0; i-- ) {
-        int c0, c1;
-        
-        c0 = colorBlock[i*4+0];
-        c1 = colorBlock[i*4+1];
+        result |= GetCoCgIndex( colorBlock[i*4+0], colorBlock[i*4+1], colors ) << ( i << 1 );
+    }
+    
+    EmitUInt( result, outData );
+}
+
+static ALWAYS_INLINE void CompressYCoCgBlockScalar( byte *block, byte **outData ) {
+    byte minColor[4];
+    byte maxColor[4];
+    
+    // A simple min max extract for each color channel including alpha             
+    GetMinMaxYCoCg( block, minColor, maxColor );
+    ScaleYCoCg( block, minColor, maxColor );    // Sets the scale in the min[2] and max[2] offset
+    InsetYCoCgBBox( minColor, maxColor );
+    SelectYCoCgDiagonal( block, minColor, maxColor );
+    
+    EmitByte( maxColor[3], outData );    // Note: the luma is stored in the alpha channel
+    EmitByte( minColor[3], outData );
+    
+    EmitAlphaIndices( block, minColor[3], maxColor[3], outData );
+    
+    EmitUShort( ColorTo565( maxColor ), outData );
+    EmitUShort( ColorTo565( minColor ), outData );
+    
+    EmitColorIndices( block, minColor, maxColor, outData );
+}
+
+// Produces the same output as CompressYCoCgBlockScalar() for a block whose texels are all the same as texel
+static void CompressUniformYCoCgBlock( const byte *texel, byte **outData ) {
+    byte minColor[4];
+    byte maxColor[4];
+    byte scaled[4];
+    byte indexes[16];
+    
+    memcpy( minColor, texel, 4 );
+    memcpy( maxColor, texel, 4 );
+    memcpy( scaled, texel, 4 );
+    int scale = ScaleYCoCgBounds( minColor, maxColor );
+    scaled[0] = ( scaled[0] - 128 ) * scale + 128;
+    scaled[1] = ( scaled[1] - 128 ) * scale + 128;
+    InsetYCoCgBBox( minColor, maxColor );
+    
+    // Every texel is on the same side of the diagonal
+    byte mid0 = ( (int) minColor[0] + maxColor[0] + 1 ) >> 1;
+    byte mid1 = ( (int) minColor[1] + maxColor[1] + 1 ) >> 1;
+    SwapYCoCgDiagonal( ( ( scaled[0] >= mid0 ) ^ ( scaled[1] >= mid1 ) ) * 16, minColor, maxColor );
+    
+    EmitByte( maxColor[3], outData );
+    EmitByte( minColor[3], outData );
+    
+    byte ab[7];
+    GetAlphaThresholds( minColor[3], maxColor[3], ab );
+    memset( indexes, GetAlphaIndex( scaled[3], ab ), 16 );
+    EmitPackedAlphaIndices( indexes, outData );
+    
+    EmitUShort( ColorTo565( maxColor ), outData );
+    EmitUShort( ColorTo565( minColor ), outData );
+    
+    word colors[4][4];
+    GetColorPalette( minColor, maxColor, colors );
+    EmitUInt( GetCoCgIndex( scaled[0], scaled[1], colors ) * 0x55555555U, outData );
+}
+
+//--- DXT1 and DXT5 Compression ---
+// The real-time bounding box method from J.M.P. van Waveren's "Real-Time DXT Compression", sharing the index selection
+// used above for YCoCg
+
+static ALWAYS_INLINE void GetMinMaxColors( const byte *colorBlock, byte *minColor, byte *maxColor ) {
+    minColor[0] = minColor[1] = minColor[2] = minColor[3] = 255;
+    maxColor[0] = maxColor[1] = maxColor[2] = maxColor[3] = 0;
+    
+    for ( int i = 0; i < 16; i++ ) {
+        for ( int j = 0; j < 4; j++ ) {
+            if ( colorBlock[i*4+j] < minColor[j] ) {
+                minColor[j] = colorBlock[i*4+j];
+            }
+            if ( colorBlock[i*4+j] > maxColor[j] ) {
+                maxColor[j] = colorBlock[i*4+j];
+            }
+        }
+    }
+}
+
+// Moves the bounds in by a fraction of their range to reduce the error of the interpolated values
+static ALWAYS_INLINE void InsetColorBBox( byte *minColor, byte *maxColor ) {
+    for ( int j = 0; j < 4; j++ ) {
+        int inset = ( maxColor[j] - minColor[j] ) >> ( j == 3 ? INSET_ALPHA_SHIFT : INSET_COLOR_SHIFT );
+        minColor[j] = minColor[j] + inset;
+        maxColor[j] = maxColor[j] - inset;
+    }
+}
+
+static ALWAYS_INLINE void EmitRGBColorIndices( const byte *colorBlock, const byte *minColor, const byte *maxColor, byte **outData ) {
+    word colors[4][4];
+    unsigned int result = 0;
+    
+    GetColorPalette( minColor, maxColor, colors );
+    
+    for ( int i = 15; i >= 0; i-- ) {
+        int c0 = colorBlock[i*4+0];
+        int c1 = colorBlock[i*4+1];
+        int c2 = colorBlock[i*4+2];
         
-        int d0 = absEA( colors[0][0] - c0 ) + absEA( colors[0][1] - c1 );
-        int d1 = absEA( colors[1][0] - c0 ) + absEA( colors[1][1] - c1 );
-        int d2 = absEA( colors[2][0] - c0 ) + absEA( colors[2][1] - c1 );
-        int d3 = absEA( colors[3][0] - c0 ) + absEA( colors[3][1] - c1 );
+        int d0 = absEA( colors[0][0] - c0 ) + absEA( colors[0][1] - c1 ) + absEA( colors[0][2] - c2 );
+        int d1 = absEA( colors[1][0] - c0 ) + absEA( colors[1][1] - c1 ) + absEA( colors[1][2] - c2 );
+        int d2 = absEA( colors[2][0] - c0 ) + absEA( colors[2][1] - c1 ) + absEA( colors[2][2] - c2 );
+        int d3 = absEA( colors[3][0] - c0 ) + absEA( colors[3][1] - c1 ) + absEA( colors[3][2] - c2 );
         
         bool b0 = d0 > d3;
         bool b1 = d1 > d2;
@@ -406,240 +629,903 @@ static void EmitColorIndices( const byte *colorBlock, const byte *minColor, cons
         int x1 = b0 & b3;
         int x2 = b0 & b4;
         
-        int indexFinal =  ( x2 | ( ( x0 | x1 ) << 1 ) ) << ( i << 1 );
-        result |= indexFinal;
+        result |= ( x2 | ( ( x0 | x1 ) << 1 ) ) << ( i << 1 );
     }
     
     EmitUInt( result, outData );
 }
 
-/*F*************************************************************************************************/
-/*!
- \Function    CompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
- 
- \Description        This is the C version of the YcoCgDXT5.  
- 
- Input data needs to be converted from ARGB to YCoCg before calling this function.
- 
- Does not support alpha at all since it uses the alpha channel to store the Y (luma).
- 
- The output size is 4:1 but will be based on rounded up texture sizes on 4 texel boundaries 
- So for example if the source texture is 33 x 32, the compressed size will be 36x32. 
- 
- The DXT5 compresses groups of 4x4 texels into 16 bytes (4:1 saving) 
- 
- The compressed format:
- 2 bytes of min and max Y luma values (these are used to rebuild an 8 element Luma table)
- 6 bytes of indexes into the luma table
- 3 bits per index so 16 indexes total 
- 2 shorts of min and max color values (these are used to rebuild a 4 element chroma table)
- 5 bits Co
- 6 bits Cg
- 5 bits Scale. The scale can only be 1, 2 or 4. 
- 4 bytes of indexes into the Chroma CocG table 
- 2 bits per index so 16 indexes total
- 
- \Input              const byte *inBuf   Input buffer of the YCoCG textel data
- \Input              const byte *outBuf  Output buffer for the compressed data
- \Input              int width           in source width 
- \Input              int height          in source height
- \Input              int stride          in source in buffer stride in bytes
- 
- \Output             int ouput size
- 
- \Version    1.1     CSidhall 01/12/09 modified to account for non aligned textures
- 1.2     1/10/10 Added stride
- */
-/*************************************************************************************************F*/
-extern "C" int CompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride) {
-    
-    int outputBytes =0;
-    
-    byte block[64];
+// Emits a DXT5 block if alpha is non-zero, otherwise a DXT1 block
+static ALWAYS_INLINE void CompressRGBABlockScalar( const byte *block, const int alpha, byte **outData ) {
     byte minColor[4];
     byte maxColor[4];
     
-    byte *outData = outBuf;
-    
-    int blockLineSize = stride * 4;  // 4 lines per loop
+    GetMinMaxColors( block, minColor, maxColor );
+    InsetColorBBox( minColor, maxColor );
     
-    for ( int j = 0; j < height; j += 4, inBuf +=blockLineSize ) {
-        int heightRemain = height - j;    
-        for ( int i = 0; i < width; i += 4 ) {
-            
-            // Note: Modified from orignal source so that it can handle the edge blending better with non aligned 4x textures
-            int widthRemain = width - i;
-            if ((heightRemain < 4) || (widthRemain < 4) ) {
-                ExtractBlock( inBuf + i * 4, stride, widthRemain, heightRemain,  block );  
-            }
-            else {
-                ExtractBlock( inBuf + i * 4, stride, block );
-            }
-            // A simple min max extract for each color channel including alpha             
-            GetMinMaxYCoCg( block, minColor, maxColor );
-            ScaleYCoCg( block, minColor, maxColor );    // Sets the scale in the min[2] and max[2] offset
-            InsetYCoCgBBox( minColor, maxColor );
-            SelectYCoCgDiagonal( block, minColor, maxColor );
-            
-            EmitByte( maxColor[3], &outData );    // Note: the luma is stored in the alpha channel
-            EmitByte( minColor[3], &outData );
-            
-            EmitAlphaIndices( block, minColor[3], maxColor[3], &outData );
-            
-            EmitUShort( ColorTo565( maxColor ), &outData );
-            EmitUShort( ColorTo565( minColor ), &outData );
-            
-            EmitColorIndices( block, minColor, maxColor, &outData );
-        }
+    if ( alpha ) {
+        EmitByte( maxColor[3], outData );
+        EmitByte( minColor[3], outData );
+        EmitAlphaIndices( block, minColor[3], maxColor[3], outData );
     }
     
-    outputBytes = (int)(outData - outBuf);
+    // The maximum is never less than the minimum, so DXT1 blocks are always in four-color mode unless the two are equal,
+    // when every texel uses the first color
+    EmitUShort( ColorTo565( maxColor ), outData );
+    EmitUShort( ColorTo565( minColor ), outData );
     
-    return outputBytes;
+    EmitRGBColorIndices( block, minColor, maxColor, outData );
 }
 
+#if defined(YCOCG_DXT_USE_SSE2)
 
-//--- YCoCgDXT5 Decompression ---
-static void RestoreLumaAlphaBlock(  const void * pSource, byte * colorBlock){
-    byte *pS=(unsigned char *) pSource;
-    byte luma[8];     
-    
-    // Grabbed this standard table building from undxt.cpp UnInterpolatedAlphaBlock() 
-    luma[0] = *pS++;                                                      
-    luma[1] = *pS++;                                                      
-    luma[2] = (byte)((6 * luma[0] + 1 * luma[1] + 3) / 7);    
-    luma[3] = (byte)((5 * luma[0] + 2 * luma[1] + 3) / 7);    
-    luma[4] = (byte)((4 * luma[0] + 3 * luma[1] + 3) / 7);    
-    luma[5] = (byte)((3 * luma[0] + 4 * luma[1] + 3) / 7);    
-    luma[6] = (byte)((2 * luma[0] + 5 * luma[1] + 3) / 7);    
-    luma[7] = (byte)((1 * luma[0] + 6 * luma[1] + 3) / 7);    
-    
-    int rawIndexes;
-    int raw;
-    int colorIndex=3;
-    // We have 6 bytes of indexes (3 bits * 16 texels)
-    // Easier to process in 2 groups of 8 texels... 
-    for(int j=0; j < 2; j++) {
-        // Pack the indexes so we can shift out the indexes as a group 
-        rawIndexes = *pS++;
-        raw = *pS++;
-        rawIndexes |= raw << 8;
-        raw = *pS++;
-        rawIndexes |= raw << 16;  
-        
-        // Since we still have to operate on the texels, just store it in a linear array workspace     
-        for(int i=0; i < 8; i++) {       
-            static const int LUMA_INDEX_FILTER = 0x7;   // To isolate the 3 bit luma index
-            
-            byte index = (byte)(rawIndexes & LUMA_INDEX_FILTER);
-            colorBlock[colorIndex] = luma[index];
-            colorIndex += 4;                                            
-            rawIndexes  >>=3;      
-        }
-    }   
+// Packs the low bits of each of sixteen bytes into a contiguous bit field, bits per byte at a time, returning the
+// packed bits of bytes 0-7 in the low 32 bits of the result and those of bytes 8-15 in the high 32 bits
+static ALWAYS_INLINE unsigned long long PackIndicesSSE2( __m128i indexes, const int bits ) {
+    __m128i packed = _mm_or_si128( indexes, _mm_slli_epi16( _mm_srli_epi16( indexes, 8 ), bits ) );
+    packed = _mm_and_si128( packed, _mm_set1_epi16( ( 1 << ( bits * 2 ) ) - 1 ) );
+    packed = _mm_or_si128( packed, _mm_slli_epi32( _mm_srli_epi32( packed, 16 ), bits * 2 ) );
+    packed = _mm_and_si128( packed, _mm_set1_epi32( ( 1 << ( bits * 4 ) ) - 1 ) );
+    packed = _mm_or_si128( packed, _mm_slli_epi64( _mm_srli_epi64( packed, 32 ), bits * 4 ) );
+    unsigned int low = (unsigned int)_mm_cvtsi128_si32( packed );
+    unsigned int high = (unsigned int)_mm_cvtsi128_si32( _mm_srli_si128( packed, 8 ) );
+    return low | ( (unsigned long long)high << 32 );
 }
 
+// Extracts one channel of sixteen texels held in four vectors into one vector of bytes
+static ALWAYS_INLINE __m128i ExtractChannelSSE2( const __m128i *texels, const int shift ) {
+    const __m128i mask = _mm_set1_epi32( 0xFF );
+    __m128i a = _mm_and_si128( _mm_srli_epi32( texels[0], shift ), mask );
+    __m128i b = _mm_and_si128( _mm_srli_epi32( texels[1], shift ), mask );
+    __m128i c = _mm_and_si128( _mm_srli_epi32( texels[2], shift ), mask );
+    __m128i d = _mm_and_si128( _mm_srli_epi32( texels[3], shift ), mask );
+    return _mm_packus_epi16( _mm_packs_epi32( a, b ), _mm_packs_epi32( c, d ) );
+}
 
-// Converts a 5.6.5 short back into 3 bytes 
-static ALWAYS_INLINE void Convert565ToColor( const unsigned short value , byte *pOutColor ) 
-{
-    int c = value >> (5+6);
-    pOutColor[0] = c << 3;  // Was a 5 bit so scale back up 
-    
-    c = value >> 5;
-    c &=0x3f;               // Filter out the top value
-    pOutColor[1] = c << 2;  // Was a 6 bit 
-    
-    c = value & 0x1f;         // Filter out the top values
-    pOutColor[2] = c << 3;  // was a 5 bit so scale back up 
+static ALWAYS_INLINE __m128i AbsDiffSSE2( __m128i a, __m128i b ) {
+    return _mm_or_si128( _mm_subs_epu8( a, b ), _mm_subs_epu8( b, a ) );
 }
 
-#ifndef EA_SYSTEM_LITTLE_ENDIAN
-// Flip around the 2 bytes in a short
-static ALWAYS_INLINE short ShortFlipBytes( short raw ) 
-{
-    return ((raw >> 8) & 0xff) | (raw << 8);
+// Sum of the absolute differences of the texels' first channelCount channels from one palette color, in 16-bit lanes
+static ALWAYS_INLINE void ColorDistanceSSE2( const __m128i *channels, const int channelCount, const word *color, __m128i *distance ) {
+    const __m128i zero = _mm_setzero_si128();
+    distance[0] = zero;
+    distance[1] = zero;
+    for ( int i = 0; i < channelCount; i++ ) {
+        __m128i d = AbsDiffSSE2( channels[i], _mm_set1_epi8( (char)color[i] ) );
+        distance[0] = _mm_add_epi16( distance[0], _mm_unpacklo_epi8( d, zero ) );
+        distance[1] = _mm_add_epi16( distance[1], _mm_unpackhi_epi8( d, zero ) );
+    }
 }
-#endif
 
-static void RestoreChromaBlock( const void * pSource, byte *colorBlock)
-{
-    unsigned short *pS =(unsigned short *) pSource;
-    pS +=4;  // Color info stars after 8 bytes (first 8 is the Y/alpha channel info)
+static ALWAYS_INLINE __m128i CompareDistancesSSE2( const __m128i *a, const __m128i *b ) {
+    return _mm_packs_epi16( _mm_cmpgt_epi16( a[0], b[0] ), _mm_cmpgt_epi16( a[1], b[1] ) );
+}
+
+// Bounds of every channel of sixteen texels held in four vectors
+static ALWAYS_INLINE void GetMinMaxSSE2( const __m128i *texels, byte *minColor, byte *maxColor ) {
+    __m128i minimum = _mm_min_epu8( _mm_min_epu8( texels[0], texels[1] ), _mm_min_epu8( texels[2], texels[3] ) );
+    __m128i maximum = _mm_max_epu8( _mm_max_epu8( texels[0], texels[1] ), _mm_max_epu8( texels[2], texels[3] ) );
+    minimum = _mm_min_epu8( minimum, _mm_shuffle_epi32( minimum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    maximum = _mm_max_epu8( maximum, _mm_shuffle_epi32( maximum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    minimum = _mm_min_epu8( minimum, _mm_shuffle_epi32( minimum, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    maximum = _mm_max_epu8( maximum, _mm_shuffle_epi32( maximum, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    int packedMin = _mm_cvtsi128_si32( minimum );
+    int packedMax = _mm_cvtsi128_si32( maximum );
+    memcpy( minColor, &packedMin, 4 );
+    memcpy( maxColor, &packedMax, 4 );
+}
+
+// Produces the same output as EmitAlphaIndices()
+static ALWAYS_INLINE void EmitAlphaIndicesSSE2( __m128i alpha, const byte minAlpha, const byte maxAlpha, byte **outData ) {
+    byte ab[7];
+    GetAlphaThresholds( minAlpha, maxAlpha, ab );
+    __m128i count = _mm_setzero_si128();
+    for ( int i = 0; i < 7; i++ ) {
+        __m128i threshold = _mm_set1_epi8( (char)ab[i] );
+        count = _mm_sub_epi8( count, _mm_cmpeq_epi8( _mm_min_epu8( alpha, threshold ), alpha ) );
+    }
+    __m128i alphaIndexes = _mm_and_si128( _mm_add_epi8( count, _mm_set1_epi8( 1 ) ), _mm_set1_epi8( 7 ) );
+    alphaIndexes = _mm_xor_si128( alphaIndexes, _mm_and_si128( _mm_cmpgt_epi8( _mm_set1_epi8( 2 ), alphaIndexes ), _mm_set1_epi8( 1 ) ) );
+    unsigned long long alphaBits = PackIndicesSSE2( alphaIndexes, 3 );
+    EmitUShort( (unsigned short)alphaBits, outData );
+    EmitByte( (byte)( alphaBits >> 16 ), outData );
+    EmitUShort( (unsigned short)( alphaBits >> 32 ), outData );
+    EmitByte( (byte)( alphaBits >> 48 ), outData );
+}
+
+// Produces the same output as EmitColorIndices() for two channels, or EmitRGBColorIndices() for three
+static ALWAYS_INLINE void EmitColorIndicesSSE2( const __m128i *channels, const int channelCount, const byte *minColor, const byte *maxColor, byte **outData ) {
+    word colors[4][4];
+    GetColorPalette( minColor, maxColor, colors );
+    __m128i d0[2], d1[2], d2[2], d3[2];
+    ColorDistanceSSE2( channels, channelCount, colors[0], d0 );
+    ColorDistanceSSE2( channels, channelCount, colors[1], d1 );
+    ColorDistanceSSE2( channels, channelCount, colors[2], d2 );
+    ColorDistanceSSE2( channels, channelCount, colors[3], d3 );
+    __m128i c0 = CompareDistancesSSE2( d0, d3 );
+    __m128i c1 = CompareDistancesSSE2( d1, d2 );
+    __m128i c2 = CompareDistancesSSE2( d0, d2 );
+    __m128i c3 = CompareDistancesSSE2( d1, d3 );
+    __m128i c4 = CompareDistancesSSE2( d2, d3 );
+    __m128i x0 = _mm_and_si128( c1, c2 );
+    __m128i x1 = _mm_and_si128( c0, c3 );
+    __m128i x2 = _mm_and_si128( c0, c4 );
+    __m128i colorIndexes = _mm_or_si128( _mm_and_si128( x2, _mm_set1_epi8( 1 ) ),
+                                         _mm_and_si128( _mm_or_si128( x0, x1 ), _mm_set1_epi8( 2 ) ) );
+    unsigned long long colorBits = PackIndicesSSE2( colorIndexes, 2 );
+    EmitUInt( (unsigned int)( colorBits | ( colorBits >> 16 ) ), outData );
+}
+
+// Produces the same output as CompressYCoCgBlockScalar()
+static ALWAYS_INLINE void CompressYCoCgBlockSSE2( const byte *block, byte **outData ) {
+    byte minColor[4];
+    byte maxColor[4];
+    __m128i texels[4];
     
-    unsigned short rawColor = *pS++;     
-#ifndef EA_SYSTEM_LITTLE_ENDIAN  
-    rawColor = ShortFlipBytes(rawColor);
-#endif
+    for ( int i = 0; i < 4; i++ ) {
+        texels[i] = _mm_loadu_si128( (const __m128i *)( block + ( i * 16 ) ) );
+    }
     
+    GetMinMaxSSE2( texels, minColor, maxColor );
     
-    byte color[4][4];   // Color workspace 
+    __m128i chroma[2];
+    __m128i co = ExtractChannelSSE2( texels, 0 );
+    __m128i cg = ExtractChannelSSE2( texels, 8 );
+    __m128i y = ExtractChannelSSE2( texels, 24 );
     
-    // Build the color lookup table 
-    // The luma should have already been extracted and sitting at offset[3]
-    Convert565ToColor( rawColor , &color[0][0] );     
-    rawColor = *pS++;     
-#ifndef EA_SYSTEM_LITTLE_ENDIAN  
-    rawColor = ShortFlipBytes(rawColor);
-#endif
+    // ( c - 128 ) * scale + 128 modulo 256 is c * scale + 128 for a scale of 2 or 4
+    int scale = ScaleYCoCgBounds( minColor, maxColor );
+    if ( scale > 1 ) {
+        const __m128i half = _mm_set1_epi8( (char)0x80 );
+        co = _mm_add_epi8( co, co );
+        cg = _mm_add_epi8( cg, cg );
+        if ( scale > 2 ) {
+            co = _mm_add_epi8( co, co );
+            cg = _mm_add_epi8( cg, cg );
+        }
+        co = _mm_xor_si128( co, half );
+        cg = _mm_xor_si128( cg, half );
+    }
     
-    Convert565ToColor( rawColor , &color[1][0] ); 
+    InsetYCoCgBBox( minColor, maxColor );
     
-    // EA/Alex Mole: mixing float & int operations is horrifyingly slow on some platforms, so we do it different!
-#if defined(__PPU__) || defined(_XBOX)
-    color[2][0] = (byte) ( ( ((int)color[0][0] * 3) + ((int)color[1][0]    ) ) >> 2 );
-    color[2][1] = (byte) ( ( ((int)color[0][1] * 3) + ((int)color[1][1]    ) ) >> 2 );
-    color[3][0] = (byte) ( ( ((int)color[0][0]    ) + ((int)color[1][0] * 3) ) >> 2 );
-    color[3][1] = (byte) ( ( ((int)color[0][1]    ) + ((int)color[1][1] * 3) ) >> 2 );
-#else
-    color[2][0] = (byte) ( (color[0][0] * 0.75f) + (color[1][0] * 0.25f) );
-    color[2][1] = (byte) ( (color[0][1] * 0.75f) + (color[1][1] * 0.25f) );
-    color[3][0] = (byte) ( (color[0][0] * 0.25f) + (color[1][0] * 0.75f) );
-    color[3][1] = (byte) ( (color[0][1] * 0.25f) + (color[1][1] * 0.75f) );
-#endif
+    __m128i mid0 = _mm_set1_epi8( (char)( ( (int) minColor[0] + maxColor[0] + 1 ) >> 1 ) );
+    __m128i mid1 = _mm_set1_epi8( (char)( ( (int) minColor[1] + maxColor[1] + 1 ) >> 1 ) );
+    __m128i b0 = _mm_cmpeq_epi8( _mm_max_epu8( co, mid0 ), co );
+    __m128i b1 = _mm_cmpeq_epi8( _mm_max_epu8( cg, mid1 ), cg );
+    int sides = _mm_movemask_epi8( _mm_xor_si128( b0, b1 ) );
+    byte side = 0;
+    for ( ; sides != 0; sides &= sides - 1 ) {
+        side++;
+    }
+    SwapYCoCgDiagonal( side, minColor, maxColor );
     
-    byte scale = ((color[0][2] >> 3) + 1) >> 1; // Adjust for shifts instead of divide
+    EmitByte( maxColor[3], outData );    // Note: the luma is stored in the alpha channel
+    EmitByte( minColor[3], outData );
     
-    // Scale back values here so we don't have to do it for all 16 texels
-    // Note: This is really only for the software version.  In hardware, the scale would need to be restored during the YCoCg to RGB conversion.
-    for(int i=0; i < 4; i++) {
-        color[i][0] = ((color[i][0] - 128) >> scale) + 128;
-        color[i][1] = ((color[i][1] - 128) >> scale) + 128;
-    }
+    EmitAlphaIndicesSSE2( y, minColor[3], maxColor[3], outData );
     
-    // Rebuild the color block using the indexes (2 bits per texel)
-    int rawIndexes;
-    int colorIndex=0;
+    EmitUShort( ColorTo565( maxColor ), outData );
+    EmitUShort( ColorTo565( minColor ), outData );
     
-    // We have 2 shorts of indexes (2 bits * 16 texels = 32 bits). (If can confirm 4x alignment, can grab it as a word with single loop) 
-    for(int j=0; j < 2; j++) {
-        rawIndexes = *pS++;
-#ifndef EA_SYSTEM_LITTLE_ENDIAN  
-        rawIndexes = ShortFlipBytes(rawIndexes);
-#endif
-        
-        // Since we still have to operate on block, just store it in a linear array workspace     
-        for(int i=0; i < 8; i++) {       
-            static const int COCG_INDEX_FILTER = 0x3;   // To isolate the 2 bit chroma index
-            
-            unsigned char index = (unsigned char)(rawIndexes & COCG_INDEX_FILTER);
-            colorBlock[colorIndex] = color[index][0];
-            colorBlock[colorIndex+1] = color[index][1];
-            colorBlock[colorIndex+2] = 255;  
-            colorIndex += 4;                                            
-            rawIndexes  >>=2;      
-        }
-    }   
+    chroma[0] = co;
+    chroma[1] = cg;
+    EmitColorIndicesSSE2( chroma, 2, minColor, maxColor, outData );
 }
 
-// This stores a 4x4 texel block but can overflow the output rectangle size if it is not 4 texels aligned in size
-static int ALWAYS_INLINE StoreBlock( const byte *colorBlock, const int stride, byte *outPtr ) {
+// Produces the same output as CompressRGBABlockScalar()
+static ALWAYS_INLINE void CompressRGBABlockSSE2( const byte *block, const int alpha, byte **outData ) {
+    byte minColor[4];
+    byte maxColor[4];
+    __m128i texels[4];
+    __m128i channels[3];
     
-    for ( int j = 0; j < 4; j++ ) {
-        memcpy( (void*) outPtr,&colorBlock[j*4*4], 4*4 );
-        outPtr += stride;
+    for ( int i = 0; i < 4; i++ ) {
+        texels[i] = _mm_loadu_si128( (const __m128i *)( block + ( i * 16 ) ) );
+    }
+    
+    GetMinMaxSSE2( texels, minColor, maxColor );
+    InsetColorBBox( minColor, maxColor );
+    
+    if ( alpha ) {
+        EmitByte( maxColor[3], outData );
+        EmitByte( minColor[3], outData );
+        EmitAlphaIndicesSSE2( ExtractChannelSSE2( texels, 24 ), minColor[3], maxColor[3], outData );
     }
-    return 64;
+    
+    EmitUShort( ColorTo565( maxColor ), outData );
+    EmitUShort( ColorTo565( minColor ), outData );
+    
+    channels[0] = ExtractChannelSSE2( texels, 0 );
+    channels[1] = ExtractChannelSSE2( texels, 8 );
+    channels[2] = ExtractChannelSSE2( texels, 16 );
+    EmitColorIndicesSSE2( channels, 3, minColor, maxColor, outData );
+}
+
+#elif defined(YCOCG_DXT_USE_NEON)
+
+static ALWAYS_INLINE byte HorizontalMinNEON( uint8x16_t v ) {
+    uint8x8_t m = vmin_u8( vget_low_u8( v ), vget_high_u8( v ) );
+    m = vpmin_u8( m, m );
+    m = vpmin_u8( m, m );
+    m = vpmin_u8( m, m );
+    return vget_lane_u8( m, 0 );
+}
+
+static ALWAYS_INLINE byte HorizontalMaxNEON( uint8x16_t v ) {
+    uint8x8_t m = vmax_u8( vget_low_u8( v ), vget_high_u8( v ) );
+    m = vpmax_u8( m, m );
+    m = vpmax_u8( m, m );
+    m = vpmax_u8( m, m );
+    return vget_lane_u8( m, 0 );
+}
+
+// Sum of the absolute differences of the texels' first channelCount channels from one palette color, in 16-bit lanes
+static ALWAYS_INLINE uint16x8x2_t ColorDistanceNEON( const uint8x16_t *channels, const int channelCount, const word *color ) {
+    uint16x8x2_t d;
+    d.val[0] = vdupq_n_u16( 0 );
+    d.val[1] = vdupq_n_u16( 0 );
+    for ( int i = 0; i < channelCount; i++ ) {
+        uint8x8_t c = vdup_n_u8( (byte)color[i] );
+        d.val[0] = vabal_u8( d.val[0], vget_low_u8( channels[i] ), c );
+        d.val[1] = vabal_u8( d.val[1], vget_high_u8( channels[i] ), c );
+    }
+    return d;
+}
+
+static ALWAYS_INLINE uint8x16_t CompareDistancesNEON( uint16x8x2_t a, uint16x8x2_t b ) {
+    return vcombine_u8( vmovn_u16( vcgtq_u16( a.val[0], b.val[0] ) ), vmovn_u16( vcgtq_u16( a.val[1], b.val[1] ) ) );
+}
+
+// Produces the same output as EmitAlphaIndices()
+static ALWAYS_INLINE void EmitAlphaIndicesNEON( uint8x16_t alpha, const byte minAlpha, const byte maxAlpha, byte **outData ) {
+    byte ab[7];
+    byte indexes[16];
+    GetAlphaThresholds( minAlpha, maxAlpha, ab );
+    uint8x16_t count = vdupq_n_u8( 0 );
+    for ( int i = 0; i < 7; i++ ) {
+        count = vsubq_u8( count, vcleq_u8( alpha, vdupq_n_u8( ab[i] ) ) );
+    }
+    uint8x16_t alphaIndexes = vandq_u8( vaddq_u8( count, vdupq_n_u8( 1 ) ), vdupq_n_u8( 7 ) );
+    alphaIndexes = veorq_u8( alphaIndexes, vandq_u8( vcltq_u8( alphaIndexes, vdupq_n_u8( 2 ) ), vdupq_n_u8( 1 ) ) );
+    vst1q_u8( indexes, alphaIndexes );
+    EmitPackedAlphaIndices( indexes, outData );
+}
+
+// Produces the same output as EmitColorIndices() for two channels, or EmitRGBColorIndices() for three
+static ALWAYS_INLINE void EmitColorIndicesNEON( const uint8x16_t *channels, const int channelCount, const byte *minColor, const byte *maxColor, byte **outData ) {
+    word colors[4][4];
+    byte indexes[16];
+    GetColorPalette( minColor, maxColor, colors );
+    uint16x8x2_t d0 = ColorDistanceNEON( channels, channelCount, colors[0] );
+    uint16x8x2_t d1 = ColorDistanceNEON( channels, channelCount, colors[1] );
+    uint16x8x2_t d2 = ColorDistanceNEON( channels, channelCount, colors[2] );
+    uint16x8x2_t d3 = ColorDistanceNEON( channels, channelCount, colors[3] );
+    uint8x16_t c0 = CompareDistancesNEON( d0, d3 );
+    uint8x16_t c1 = CompareDistancesNEON( d1, d2 );
+    uint8x16_t c2 = CompareDistancesNEON( d0, d2 );
+    uint8x16_t c3 = CompareDistancesNEON( d1, d3 );
+    uint8x16_t c4 = CompareDistancesNEON( d2, d3 );
+    uint8x16_t x0 = vandq_u8( c1, c2 );
+    uint8x16_t x1 = vandq_u8( c0, c3 );
+    uint8x16_t x2 = vandq_u8( c0, c4 );
+    uint8x16_t colorIndexes = vorrq_u8( vandq_u8( x2, vdupq_n_u8( 1 ) ), vandq_u8( vorrq_u8( x0, x1 ), vdupq_n_u8( 2 ) ) );
+    vst1q_u8( indexes, colorIndexes );
+    unsigned int result = 0;
+    for ( int i = 0; i < 16; i++ ) {
+        result |= (unsigned int)indexes[i] << ( i << 1 );
+    }
+    EmitUInt( result, outData );
+}
+
+// Produces the same output as CompressYCoCgBlockScalar()
+static ALWAYS_INLINE void CompressYCoCgBlockNEON( const byte *block, byte **outData ) {
+    byte minColor[4];
+    byte maxColor[4];
+    
+    uint8x16x4_t texels = vld4q_u8( block );
+    uint8x16_t co = texels.val[0];
+    uint8x16_t cg = texels.val[1];
+    uint8x16_t y = texels.val[3];
+    
+    minColor[0] = HorizontalMinNEON( co );
+    minColor[1] = HorizontalMinNEON( cg );
+    minColor[2] = 255;
+    minColor[3] = HorizontalMinNEON( y );
+    maxColor[0] = HorizontalMaxNEON( co );
+    maxColor[1] = HorizontalMaxNEON( cg );
+    maxColor[2] = 0;
+    maxColor[3] = HorizontalMaxNEON( y );
+    
+    // ( c - 128 ) * scale + 128 modulo 256 is c * scale + 128 for a scale of 2 or 4
+    int scale = ScaleYCoCgBounds( minColor, maxColor );
+    if ( scale > 1 ) {
+        const uint8x16_t half = vdupq_n_u8( 0x80 );
+        co = vaddq_u8( co, co );
+        cg = vaddq_u8( cg, cg );
+        if ( scale > 2 ) {
+            co = vaddq_u8( co, co );
+            cg = vaddq_u8( cg, cg );
+        }
+        co = veorq_u8( co, half );
+        cg = veorq_u8( cg, half );
+    }
+    
+    InsetYCoCgBBox( minColor, maxColor );
+    
+    uint8x16_t b0 = vcgeq_u8( co, vdupq_n_u8( (byte)( ( (int) minColor[0] + maxColor[0] + 1 ) >> 1 ) ) );
+    uint8x16_t b1 = vcgeq_u8( cg, vdupq_n_u8( (byte)( ( (int) minColor[1] + maxColor[1] + 1 ) >> 1 ) ) );
+    uint8x16_t sides = vandq_u8( veorq_u8( b0, b1 ), vdupq_n_u8( 1 ) );
+    uint64x2_t sum = vpaddlq_u32( vpaddlq_u16( vpaddlq_u8( sides ) ) );
+    byte side = (byte)( vgetq_lane_u64( sum, 0 ) + vgetq_lane_u64( sum, 1 ) );
+    SwapYCoCgDiagonal( side, minColor, maxColor );
+    
+    EmitByte( maxColor[3], outData );    // Note: the luma is stored in the alpha channel
+    EmitByte( minColor[3], outData );
+    
+    EmitAlphaIndicesNEON( y, minColor[3], maxColor[3], outData );
+    
+    EmitUShort( ColorTo565( maxColor ), outData );
+    EmitUShort( ColorTo565( minColor ), outData );
+    
+    uint8x16_t chroma[2] = { co, cg };
+    EmitColorIndicesNEON( chroma, 2, minColor, maxColor, outData );
+}
+
+// Produces the same output as CompressRGBABlockScalar()
+static ALWAYS_INLINE void CompressRGBABlockNEON( const byte *block, const int alpha, byte **outData ) {
+    byte minColor[4];
+    byte maxColor[4];
+    
+    uint8x16x4_t texels = vld4q_u8( block );
+    
+    for ( int i = 0; i < 4; i++ ) {
+        minColor[i] = HorizontalMinNEON( texels.val[i] );
+        maxColor[i] = HorizontalMaxNEON( texels.val[i] );
+    }
+    InsetColorBBox( minColor, maxColor );
+    
+    if ( alpha ) {
+        EmitByte( maxColor[3], outData );
+        EmitByte( minColor[3], outData );
+        EmitAlphaIndicesNEON( texels.val[3], minColor[3], maxColor[3], outData );
+    }
+    
+    EmitUShort( ColorTo565( maxColor ), outData );
+    EmitUShort( ColorTo565( minColor ), outData );
+    
+    EmitColorIndicesNEON( texels.val, 3, minColor, maxColor, outData );
+}
+
+#endif
+
+static ALWAYS_INLINE void CompressYCoCgBlock( byte *block, byte **outData ) {
+#if defined(YCOCG_DXT_USE_SSE2)
+    CompressYCoCgBlockSSE2( block, outData );
+#elif defined(YCOCG_DXT_USE_NEON)
+    CompressYCoCgBlockNEON( block, outData );
+#else
+    CompressYCoCgBlockScalar( block, outData );
+#endif
+}
+
+static ALWAYS_INLINE void CompressRGBABlock( const byte *block, const int alpha, byte **outData ) {
+#if defined(YCOCG_DXT_USE_SSE2)
+    CompressRGBABlockSSE2( block, alpha, outData );
+#elif defined(YCOCG_DXT_USE_NEON)
+    CompressRGBABlockNEON( block, alpha, outData );
+#else
+    CompressRGBABlockScalar( block, alpha, outData );
+#endif
+}
+
+//--- Repeated Blocks ---
+// Flat areas and repeated graphics give many identical blocks. A uniform block is encoded directly, and the output for
+// other blocks is kept in a small cache keyed by their texels, so a repeat of a recent block is copied rather than
+// compressed again. The output is the same as compressing every block. Where the cache finds no repeats it is bypassed
+// for a while, so content without them pays little for it.
+
+#define BLOCK_CACHE_BITS        6
+#define BLOCK_CACHE_PROBE       256     // lookups without a hit before the cache is bypassed
+#define BLOCK_CACHE_BYPASS      1024    // blocks for which the cache is then bypassed
+
+typedef struct {
+    byte texels[64];
+    byte output[16];
+    int valid;
+} BlockCacheEntry;
+
+typedef struct {
+    BlockCacheEntry entries[1 << BLOCK_CACHE_BITS];
+    int misses;
+    int bypass;
+} BlockCache;
+
+static void InitBlockCache( BlockCache *cache ) {
+    for ( int i = 0; i < ( 1 << BLOCK_CACHE_BITS ); i++ ) {
+        cache->entries[i].valid = 0;
+    }
+    cache->misses = 0;
+    cache->bypass = 0;
+}
+
+static ALWAYS_INLINE int IsUniformBlock( const byte *block ) {
+    unsigned int first;
+    memcpy( &first, block, 4 );
+    for ( int i = 1; i < 16; i++ ) {
+        unsigned int texel;
+        memcpy( &texel, block + ( i * 4 ), 4 );
+        if ( texel != first ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static ALWAYS_INLINE unsigned int HashBlock( const byte *block ) {
+    unsigned int hash = 0;
+    for ( int i = 0; i < 16; i++ ) {
+        unsigned int texel;
+        memcpy( &texel, block + ( i * 4 ), 4 );
+        hash += texel * ( 0x9E3779B1U + ( i << 1 ) );
+    }
+    return hash >> ( 32 - BLOCK_CACHE_BITS );
+}
+
+// Returns the entry for block, setting hit if it holds the output for block, or NULL if the cache is being bypassed
+static ALWAYS_INLINE BlockCacheEntry *LookUpBlockCache( BlockCache *cache, const byte *block, int *hit ) {
+    if ( cache->bypass > 0 ) {
+        cache->bypass--;
+        return NULL;
+    }
+    BlockCacheEntry *entry = &cache->entries[HashBlock( block )];
+    *hit = entry->valid && memcmp( entry->texels, block, 64 ) == 0;
+    if ( *hit ) {
+        cache->misses = 0;
+    }
+    else if ( ++cache->misses == BLOCK_CACHE_PROBE ) {
+        cache->misses = 0;
+        cache->bypass = BLOCK_CACHE_BYPASS;
+    }
+    return entry;
+}
+
+// Compresses a YCoCg block, using the cache and the uniform block path where possible
+static ALWAYS_INLINE void CompressYCoCgBlockCached( BlockCache *cache, byte *block, byte **outData ) {
+    if ( IsUniformBlock( block ) ) {
+        CompressUniformYCoCgBlock( block, outData );
+        return;
+    }
+    int hit;
+    BlockCacheEntry *entry = LookUpBlockCache( cache, block, &hit );
+    if ( entry == NULL ) {
+        CompressYCoCgBlock( block, outData );
+    }
+    else if ( hit ) {
+        memcpy( *outData, entry->output, 16 );
+        *outData += 16;
+    }
+    else {
+        byte *output = *outData;
+        memcpy( entry->texels, block, 64 );     // before compressing, which may modify block
+        CompressYCoCgBlock( block, outData );
+        memcpy( entry->output, output, 16 );
+        entry->valid = 1;
+    }
+}
+
+// convert is non-zero for RGBA texels, and swapRedBlue for BGRA
+static ALWAYS_INLINE int CompressYCoCgBlocks( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride, const int convert, const int swapRedBlue ) {
+    
+    byte block[64];
+    BlockCache cache;
+    
+    byte *outData = outBuf;
+    
+    int blockLineSize = stride * 4;  // 4 lines per loop
+    
+    InitBlockCache( &cache );
+    
+    for ( int j = 0; j < height; j += 4, inBuf +=blockLineSize ) {
+        int heightRemain = height - j;    
+        for ( int i = 0; i < width; i += 4 ) {
+            
+            // Note: Modified from orignal source so that it can handle the edge blending better with non aligned 4x textures
+            int widthRemain = width - i;
+            if ((heightRemain < 4) || (widthRemain < 4) ) {
+                ExtractBlock( inBuf + i * 4, stride, widthRemain, heightRemain,  block );  
+            }
+            else {
+                ExtractBlock( inBuf + i * 4, stride, block );
+            }
+            if ( swapRedBlue ) {
+                SwapBlockRedBlue( block );
+            }
+            if ( convert ) {
+                ConvertBlockRGBAToCoCg_Y( block );
+            }
+            CompressYCoCgBlockCached( &cache, block, &outData );
+        }
+    }
+    
+    return (int)(outData - outBuf);
+}
+
+// swapRedBlue is non-zero for BGRA texels
+static ALWAYS_INLINE int CompressRGBABlocks( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride, const int alpha, const int swapRedBlue ) {
+    
+    byte block[64];
+    
+    byte *outData = outBuf;
+    
+    int blockLineSize = stride * 4;  // 4 lines per loop
+    
+    for ( int j = 0; j < height; j += 4, inBuf +=blockLineSize ) {
+        int heightRemain = height - j;    
+        for ( int i = 0; i < width; i += 4 ) {
+            int widthRemain = width - i;
+            if ((heightRemain < 4) || (widthRemain < 4) ) {
+                ExtractBlock( inBuf + i * 4, stride, widthRemain, heightRemain,  block );  
+            }
+            else {
+                ExtractBlock( inBuf + i * 4, stride, block );
+            }
+            if ( swapRedBlue ) {
+                SwapBlockRedBlue( block );
+            }
+            CompressRGBABlock( block, alpha, &outData );
+        }
+    }
+    
+    return (int)(outData - outBuf);
+}
+
+extern "C" int CompressRGBAToDXT1( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) {
+    return CompressRGBABlocks( inBuf, outBuf, width, height, stride, 0, 0 );
+}
+
+extern "C" int CompressRGBAToDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) {
+    return CompressRGBABlocks( inBuf, outBuf, width, height, stride, 1, 0 );
+}
+
+extern "C" int CompressBGRAToDXT1( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) {
+    return CompressRGBABlocks( inBuf, outBuf, width, height, stride, 0, 1 );
+}
+
+extern "C" int CompressBGRAToDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) {
+    return CompressRGBABlocks( inBuf, outBuf, width, height, stride, 1, 1 );
+}
+
+/*F*************************************************************************************************/
+/*!
+ \Function    CompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ 
+ \Description        This is the C version of the YcoCgDXT5.  
+ 
+ Input data needs to be converted from ARGB to YCoCg before calling this function.
+ 
+ Does not support alpha at all since it uses the alpha channel to store the Y (luma).
+ 
+ The output size is 4:1 but will be based on rounded up texture sizes on 4 texel boundaries 
+ So for example if the source texture is 33 x 32, the compressed size will be 36x32. 
+ 
+ The DXT5 compresses groups of 4x4 texels into 16 bytes (4:1 saving) 
+ 
+ The compressed format:
+ 2 bytes of min and max Y luma values (these are used to rebuild an 8 element Luma table)
+ 6 bytes of indexes into the luma table
+ 3 bits per index so 16 indexes total 
+ 2 shorts of min and max color values (these are used to rebuild a 4 element chroma table)
+ 5 bits Co
+ 6 bits Cg
+ 5 bits Scale. The scale can only be 1, 2 or 4. 
+ 4 bytes of indexes into the Chroma CocG table 
+ 2 bits per index so 16 indexes total
+ 
+ \Input              const byte *inBuf   Input buffer of the YCoCG textel data
+ \Input              const byte *outBuf  Output buffer for the compressed data
+ \Input              int width           in source width 
+ \Input              int height          in source height
+ \Input              int stride          in source in buffer stride in bytes
+ 
+ \Output             int ouput size
+ 
+ \Version    1.1     CSidhall 01/12/09 modified to account for non aligned textures
+ 1.2     1/10/10 Added stride
+ */
+/*************************************************************************************************F*/
+extern "C" int CompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride) {
+    return CompressYCoCgBlocks( inBuf, outBuf, width, height, stride, 0, 0 );
+}
+
+
+/*F*************************************************************************************************/
+/*!
+ \Function    CompressRGBAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ 
+ \Description  As CompressYCoCgDXT5() but takes RGBA texels and converts each 4x4 block to YCoCg as it is extracted,
+ so no intermediate YCoCg image is needed. The output is identical to calling ConvertRGB_ToCoCg_Y8888() followed
+ by CompressYCoCgDXT5().
+ 
+ \Input              const byte *inBuf   Input buffer of the RGBA textel data
+ \Input              const byte *outBuf  Output buffer for the compressed data
+ \Input              int width           in source width 
+ \Input              int height          in source height
+ \Input              int stride          in source in buffer stride in bytes
+ 
+ \Output             int ouput size
+ */
+/*************************************************************************************************F*/
+extern "C" int CompressRGBAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride) {
+    return CompressYCoCgBlocks( inBuf, outBuf, width, height, stride, 1, 0 );
+}
+
+extern "C" int CompressBGRAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride) {
+    return CompressYCoCgBlocks( inBuf, outBuf, width, height, stride, 1, 1 );
+}
+
+
+//--- YCoCgDXT5 Decompression ---
+
+// Converts a 5.6.5 short back into 3 bytes 
+static ALWAYS_INLINE void Convert565ToColor( const unsigned short value , byte *pOutColor ) 
+{
+    int c = value >> (5+6);
+    pOutColor[0] = c << 3;  // Was a 5 bit so scale back up 
+    
+    c = value >> 5;
+    c &=0x3f;               // Filter out the top value
+    pOutColor[1] = c << 2;  // Was a 6 bit 
+    
+    c = value & 0x1f;         // Filter out the top values
+    pOutColor[2] = c << 3;  // was a 5 bit so scale back up 
+}
+
+// Builds the four chroma values of a block, with the scale removed.
+// The block is read a byte at a time so this is independent of the platform's byte order.
+static ALWAYS_INLINE void RestoreChromaPalette( const byte *pSource, byte chroma[4][2] )
+{
+    byte color[4][4];   // Color workspace 
+    
+    Convert565ToColor( pSource[8] | ( pSource[9] << 8 ), &color[0][0] );
+    Convert565ToColor( pSource[10] | ( pSource[11] << 8 ), &color[1][0] );
+    
+    // Exactly ( color * 0.75f ) + ( color * 0.25f ) truncated, without mixing float and int operations
+    color[2][0] = (byte) ( ( ((int)color[0][0] * 3) + ((int)color[1][0]    ) ) >> 2 );
+    color[2][1] = (byte) ( ( ((int)color[0][1] * 3) + ((int)color[1][1]    ) ) >> 2 );
+    color[3][0] = (byte) ( ( ((int)color[0][0]    ) + ((int)color[1][0] * 3) ) >> 2 );
+    color[3][1] = (byte) ( ( ((int)color[0][1]    ) + ((int)color[1][1] * 3) ) >> 2 );
+    
+    byte scale = ((color[0][2] >> 3) + 1) >> 1; // Adjust for shifts instead of divide
+    
+    // Scale back values here so we don't have to do it for all 16 texels
+    for(int i=0; i < 4; i++) {
+        chroma[i][0] = ((color[i][0] - 128) >> scale) + 128;
+        chroma[i][1] = ((color[i][1] - 128) >> scale) + 128;
+    }
+}
+
+// Builds the eight luma values and four chroma values of a block, and reads its indices into them
+static ALWAYS_INLINE void RestoreBlockPalettes( const byte *pSource, byte *luma, byte chroma[4][2], unsigned long long *lumaIndexes, unsigned int *chromaIndexes )
+{
+    // Grabbed this standard table building from undxt.cpp UnInterpolatedAlphaBlock() 
+    luma[0] = pSource[0];
+    luma[1] = pSource[1];
+    luma[2] = (byte)((6 * luma[0] + 1 * luma[1] + 3) / 7);    
+    luma[3] = (byte)((5 * luma[0] + 2 * luma[1] + 3) / 7);    
+    luma[4] = (byte)((4 * luma[0] + 3 * luma[1] + 3) / 7);    
+    luma[5] = (byte)((3 * luma[0] + 4 * luma[1] + 3) / 7);    
+    luma[6] = (byte)((2 * luma[0] + 5 * luma[1] + 3) / 7);    
+    luma[7] = (byte)((1 * luma[0] + 6 * luma[1] + 3) / 7);    
+    
+    // 6 bytes of indexes (3 bits * 16 texels)
+    *lumaIndexes = 0;
+    for ( int i = 7; i >= 2; i-- ) {
+        *lumaIndexes = ( *lumaIndexes << 8 ) | pSource[i];
+    }
+    
+    RestoreChromaPalette( pSource, chroma );
+    
+    // 4 bytes of indexes (2 bits * 16 texels)
+    *chromaIndexes = pSource[12] | ( pSource[13] << 8 ) | ( pSource[14] << 16 ) | ( (unsigned int)pSource[15] << 24 );
+}
+
+// Decodes a block to CoCg_Y texels in four rows of 16 bytes, stride bytes apart
+static ALWAYS_INLINE void DecodeBlockYCoCg( const byte *pSource, byte *outPtr, const int stride )
+{
+    byte luma[8];
+    byte chroma[4][2];
+    unsigned long long lumaIndexes;
+    unsigned int chromaIndexes;
+    
+    RestoreBlockPalettes( pSource, luma, chroma, &lumaIndexes, &chromaIndexes );
+    
+#ifdef EA_SYSTEM_LITTLE_ENDIAN
+    // Whole texels from two small tables
+    unsigned int lumaTexels[8];
+    unsigned int chromaTexels[4];
+    for ( int i = 0; i < 8; i++ ) {
+        lumaTexels[i] = (unsigned int)luma[i] << 24;
+    }
+    for ( int i = 0; i < 4; i++ ) {
+        chromaTexels[i] = chroma[i][0] | ( chroma[i][1] << 8 ) | ( 255 << 16 );
+    }
+    for ( int j = 0; j < 4; j++, outPtr += stride ) {
+        unsigned int row[4];
+        for ( int i = 0; i < 4; i++ ) {
+            row[i] = chromaTexels[chromaIndexes & 3] | lumaTexels[lumaIndexes & 7];
+            chromaIndexes >>= 2;
+            lumaIndexes >>= 3;
+        }
+        memcpy( outPtr, row, 16 );
+    }
+#else
+    for ( int j = 0; j < 4; j++, outPtr += stride ) {
+        for ( int i = 0; i < 4; i++ ) {
+            outPtr[i*4+0] = chroma[chromaIndexes & 3][0];
+            outPtr[i*4+1] = chroma[chromaIndexes & 3][1];
+            outPtr[i*4+2] = 255;
+            outPtr[i*4+3] = luma[lumaIndexes & 7];
+            chromaIndexes >>= 2;
+            lumaIndexes >>= 3;
+        }
+    }
+#endif
+}
+
+#if defined(YCOCG_DXT_USE_SSE2)
+
+// Decodes a block to CoCg_Y texels, or to RGBA as described for DecodeBlockRGBA(), in four rows of 16 bytes, stride
+// bytes apart. Eight texels are decoded at a time in 16-bit lanes. Each lane's index is multiplied up to the top of the
+// lane and shifted down, luma is interpolated arithmetically rather than looked up, and chroma is selected by comparison.
+static ALWAYS_INLINE void DecodeBlockSSE2( const byte *pSource, byte *outPtr, const int stride, const int rgba )
+{
+    byte chroma[4][2];
+    RestoreChromaPalette( pSource, chroma );
+    
+    // Lanes 5 to 7 take their luma index from the upper 16 bits of each 24 bits of indices
+    const __m128i lumaWindow = _mm_set_epi16( -1, -1, -1, 0, 0, 0, 0, 0 );
+    const __m128i lumaShift = _mm_set_epi16( 1, 8, 64, 2, 16, 128, 1024, 8192 );
+    const __m128i chromaShift = _mm_set_epi16( 1, 4, 16, 64, 256, 1024, 4096, 16384 );
+    const __m128i luma0 = _mm_set1_epi16( pSource[0] );
+    const __m128i luma1 = _mm_set1_epi16( pSource[1] );
+    const __m128i chroma0 = _mm_set1_epi16( (short)( chroma[0][0] | ( chroma[0][1] << 8 ) ) );
+    const __m128i chroma1 = _mm_set1_epi16( (short)( chroma[1][0] | ( chroma[1][1] << 8 ) ) );
+    const __m128i chroma2 = _mm_set1_epi16( (short)( chroma[2][0] | ( chroma[2][1] << 8 ) ) );
+    const __m128i chroma3 = _mm_set1_epi16( (short)( chroma[3][0] | ( chroma[3][1] << 8 ) ) );
+    const __m128i low = _mm_set1_epi16( 0xFF );
+    
+    for ( int half = 0; half < 2; half++ ) {
+        unsigned int lumaBits = pSource[2 + half * 3] | ( pSource[3 + half * 3] << 8 ) | ( pSource[4 + half * 3] << 16 );
+        __m128i lumaIndexes = _mm_or_si128( _mm_andnot_si128( lumaWindow, _mm_set1_epi16( (short)lumaBits ) ),
+                                            _mm_and_si128( lumaWindow, _mm_set1_epi16( (short)( lumaBits >> 8 ) ) ) );
+        lumaIndexes = _mm_srli_epi16( _mm_mullo_epi16( lumaIndexes, lumaShift ), 13 );
+        
+        // Luma index 0 is all of luma[0], 1 is all of luma[1], and 2 to 7 are ( 8 - index ) and ( index - 1 ) sevenths
+        // of each. ( v * 9363 ) >> 16 is v / 7 for every v in range.
+        __m128i weight0 = _mm_sub_epi16( _mm_set1_epi16( 8 ), lumaIndexes );
+        weight0 = _mm_add_epi16( weight0, _mm_cmpeq_epi16( lumaIndexes, _mm_setzero_si128() ) );
+        weight0 = _mm_sub_epi16( weight0, _mm_and_si128( _mm_cmpeq_epi16( lumaIndexes, _mm_set1_epi16( 1 ) ), _mm_set1_epi16( 7 ) ) );
+        __m128i weight1 = _mm_sub_epi16( _mm_set1_epi16( 7 ), weight0 );
+        __m128i y = _mm_add_epi16( _mm_add_epi16( _mm_mullo_epi16( weight0, luma0 ), _mm_mullo_epi16( weight1, luma1 ) ), _mm_set1_epi16( 3 ) );
+        y = _mm_mulhi_epu16( y, _mm_set1_epi16( 9363 ) );
+        
+        unsigned int chromaBits = pSource[12 + half * 2] | ( pSource[13 + half * 2] << 8 );
+        __m128i chromaIndexes = _mm_srli_epi16( _mm_mullo_epi16( _mm_set1_epi16( (short)chromaBits ), chromaShift ), 14 );
+        // Co in the low byte and Cg in the high byte of each lane
+        __m128i cocg = _mm_and_si128( _mm_cmpeq_epi16( chromaIndexes, _mm_setzero_si128() ), chroma0 );
+        cocg = _mm_or_si128( cocg, _mm_and_si128( _mm_cmpeq_epi16( chromaIndexes, _mm_set1_epi16( 1 ) ), chroma1 ) );
+        cocg = _mm_or_si128( cocg, _mm_and_si128( _mm_cmpeq_epi16( chromaIndexes, _mm_set1_epi16( 2 ) ), chroma2 ) );
+        cocg = _mm_or_si128( cocg, _mm_and_si128( _mm_cmpeq_epi16( chromaIndexes, _mm_set1_epi16( 3 ) ), chroma3 ) );
+        
+        __m128i row0, row1;
+        if ( rgba ) {
+            __m128i co = _mm_and_si128( cocg, low );
+            __m128i cg = _mm_srli_epi16( cocg, 8 );
+            __m128i r = _mm_sub_epi16( _mm_add_epi16( y, co ), cg );
+            __m128i g = _mm_sub_epi16( _mm_add_epi16( y, cg ), _mm_set1_epi16( 128 ) );
+            __m128i b = _mm_sub_epi16( _mm_sub_epi16( _mm_add_epi16( y, _mm_set1_epi16( 256 ) ), co ), cg );
+            __m128i rg = _mm_packus_epi16( r, g );
+            __m128i ba = _mm_packus_epi16( b, low );
+            __m128i rb = _mm_unpacklo_epi8( rg, ba );
+            __m128i ga = _mm_unpackhi_epi8( rg, ba );
+            row0 = _mm_unpacklo_epi8( rb, ga );
+            row1 = _mm_unpackhi_epi8( rb, ga );
+        }
+        else {
+            __m128i ay = _mm_or_si128( _mm_slli_epi16( y, 8 ), low );
+            row0 = _mm_unpacklo_epi16( cocg, ay );
+            row1 = _mm_unpackhi_epi16( cocg, ay );
+        }
+        _mm_storeu_si128( (__m128i *)outPtr, row0 );
+        outPtr += stride;
+        _mm_storeu_si128( (__m128i *)outPtr, row1 );
+        outPtr += stride;
+    }
+}
+
+#endif
+
+#if defined(YCOCG_DXT_USE_NEON)
+// Clamps and stores four texels, each four 16-bit channels of R, G, B and A biased by 256, as RGBA
+static ALWAYS_INLINE void StoreRGBARowNEON( const unsigned long long *texels, byte *outPtr )
+{
+    const int16x8_t bias = vdupq_n_s16( 256 );
+    int16x8_t low = vsubq_s16( vreinterpretq_s16_u16( vcombine_u16( vcreate_u16( texels[0] ), vcreate_u16( texels[1] ) ) ), bias );
+    int16x8_t high = vsubq_s16( vreinterpretq_s16_u16( vcombine_u16( vcreate_u16( texels[2] ), vcreate_u16( texels[3] ) ) ), bias );
+    vst1q_u8( outPtr, vcombine_u8( vqmovun_s16( low ), vqmovun_s16( high ) ) );
+}
+#endif
+
+static ALWAYS_INLINE byte ClampToByte( int c )
+{
+    return (byte)( c < 0 ? 0 : ( c > 255 ? 255 : c ) );
+}
+
+// Decodes a block to RGBA texels in four rows of 16 bytes, stride bytes apart.
+// The conversion is the same as ConvertCoCg_Y8888ToRGB_(), with alpha set to 255:
+//  R = Y + Co - Cg
+//  G = Y + Cg - 128
+//  B = Y - Co - Cg + 256
+static ALWAYS_INLINE void DecodeBlockRGBA( const byte *pSource, byte *outPtr, const int stride )
+{
+    byte luma[8];
+    byte chroma[4][2];
+    unsigned long long lumaIndexes;
+    unsigned int chromaIndexes;
+    
+    RestoreBlockPalettes( pSource, luma, chroma, &lumaIndexes, &chromaIndexes );
+    
+#if defined(YCOCG_DXT_USE_NEON)
+    // Every term is formed in its own 16-bit lane with a bias of 256 so the lanes of a texel can be summed as one integer
+    unsigned long long lumaTerms[8];
+    unsigned long long chromaTerms[4];
+    for ( int i = 0; i < 8; i++ ) {
+        unsigned long long y = luma[i];
+        lumaTerms[i] = y | ( y << 16 ) | ( y << 32 ) | ( 255ULL << 48 );
+    }
+    for ( int i = 0; i < 4; i++ ) {
+        int co = chroma[i][0];
+        int cg = chroma[i][1];
+        chromaTerms[i] = (unsigned long long)( co - cg + 256 )
+                       | ( (unsigned long long)( cg - 128 + 256 ) << 16 )
+                       | ( (unsigned long long)( 256 - co - cg + 256 ) << 32 )
+                       | ( 256ULL << 48 );
+    }
+    
+    for ( int j = 0; j < 4; j++, outPtr += stride ) {
+        unsigned long long row[4];
+        for ( int i = 0; i < 4; i++ ) {
+            row[i] = chromaTerms[chromaIndexes & 3] + lumaTerms[lumaIndexes & 7];
+            chromaIndexes >>= 2;
+            lumaIndexes >>= 3;
+        }
+        StoreRGBARowNEON( row, outPtr );
+    }
+#else
+    int chromaTerms[4][3];
+    for ( int i = 0; i < 4; i++ ) {
+        int co = chroma[i][0];
+        int cg = chroma[i][1];
+        chromaTerms[i][0] = co - cg;
+        chromaTerms[i][1] = cg - 128;
+        chromaTerms[i][2] = 256 - co - cg;
+    }
+    
+    for ( int j = 0; j < 4; j++, outPtr += stride ) {
+        for ( int i = 0; i < 4; i++ ) {
+            const int *c = chromaTerms[chromaIndexes & 3];
+            int y = luma[lumaIndexes & 7];
+            outPtr[i*4+0] = ClampToByte( y + c[0] );
+            outPtr[i*4+1] = ClampToByte( y + c[1] );
+            outPtr[i*4+2] = ClampToByte( y + c[2] );
+            outPtr[i*4+3] = 255;
+            chromaIndexes >>= 2;
+            lumaIndexes >>= 3;
+        }
+    }
+#endif
 }
 
 // This store only the texels that are within the width and height boundaries so does not overflow
@@ -677,6 +1563,51 @@ static int StoreBlock( const byte *colorBlock , const int stride, const int widt
 
 
 
+static ALWAYS_INLINE void DecodeBlock( const byte *pSource, byte *outPtr, const int stride, const int rgba )
+{
+#if defined(YCOCG_DXT_USE_SSE2)
+    DecodeBlockSSE2( pSource, outPtr, stride, rgba );
+#else
+    if( rgba ) {
+        DecodeBlockRGBA( pSource, outPtr, stride );
+    }
+    else {
+        DecodeBlockYCoCg( pSource, outPtr, stride );
+    }
+#endif
+}
+
+// Decodes whole blocks straight to the output and edge blocks through a work space
+static ALWAYS_INLINE int DeCompressYCoCgDXT5Blocks( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride, const int rgba )
+{
+    byte colorBlock[64];    // 4x4 texel work space a linear array 
+    int outByteCount =0;
+    const byte *pCurInBuffer = inBuf;
+    
+    int blockLineSize = stride * 4;  // 4 lines per loop
+    for( int j = 0; j < height; j += 4, outBuf += blockLineSize )
+    {
+        int heightRemain = height - j;
+        for( int i = 0; i < width; i += 4 )
+        {
+            int widthRemain = width - i;
+            if( heightRemain >= 4 && widthRemain >= 4 )
+            {
+                DecodeBlock(pCurInBuffer, outBuf + i * 4, stride, rgba);
+                outByteCount += 64;
+            }
+            else
+            {
+                DecodeBlock(pCurInBuffer, colorBlock, 16, rgba);
+                outByteCount += StoreBlock(colorBlock , stride, widthRemain, heightRemain,  outBuf + i * 4);
+            }
+            pCurInBuffer += 16; // 16 bytes per block of compressed data
+        }
+    }
+    
+    return outByteCount;
+}
+
 /*F*************************************************************************************************/
 /*!
  \Function    DeCompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
@@ -718,52 +1649,27 @@ static int StoreBlock( const byte *colorBlock , const int stride, const int widt
 /*************************************************************************************************F*/
 extern "C" int DeCompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride )
 {
-    byte colorBlock[64];    // 4x4 texel work space a linear array 
-    int outByteCount =0;
-    const byte *pCurInBuffer = inBuf;
-    
-    int blockLineSize = stride * 4;  // 4 lines per loop
-    for( int j = 0; j < ( height & ~3 ); j += 4, outBuf += blockLineSize )
-    {
-        int i;
-        for( i = 0; i < ( width & ~3 ); i += 4 )
-        {
-            RestoreLumaAlphaBlock(pCurInBuffer, colorBlock);
-            RestoreChromaBlock(pCurInBuffer, colorBlock);           
-            outByteCount += StoreBlock(colorBlock, stride, outBuf + i * 4);
-            pCurInBuffer += 16; // 16 bytes per block of compressed data
-        }
-        
-        // Do we have some leftover columns?
-        if( width & 3 )
-        {
-            int widthRemain = width & 3;
-            
-            RestoreLumaAlphaBlock(pCurInBuffer, colorBlock);
-            RestoreChromaBlock(pCurInBuffer, colorBlock);
-            
-            outByteCount += StoreBlock(colorBlock , stride, widthRemain, 4 /* heightRemain >= 4 */, outBuf + i * 4);
-            
-            pCurInBuffer += 16; // 16 bytes per block of compressed data
-        }
-    }
-    
-    // Do we have some leftover lines?
-    if( height & 3 )
-    {
-        int heightRemain = height & 3;
-        
-        for( int i = 0; i < width; i += 4 )
-        {
-            RestoreLumaAlphaBlock(pCurInBuffer, colorBlock);
-            RestoreChromaBlock(pCurInBuffer, colorBlock);
-            
-            int widthRemain = width - i;
-            outByteCount += StoreBlock(colorBlock , stride, widthRemain, heightRemain,  outBuf + i * 4);
-            
-            pCurInBuffer += 16; // 16 bytes per block of compressed data
-        }
-    }
-    
-    return outByteCount;
+    return DeCompressYCoCgDXT5Blocks( inBuf, outBuf, width, height, stride, 0 );
+}
+
+
+/*F*************************************************************************************************/
+/*!
+ \Function    DeCompressYCoCgDXT5ToRGBA( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ 
+ \Description  As DeCompressYCoCgDXT5() but converts each block to RGBA as it is decoded, with alpha set to 255.
+ The output is identical to calling DeCompressYCoCgDXT5() followed by ConvertCoCg_Y8888ToRGB_() and setting alpha.
+ 
+ \Input          const byte *inBuf
+ \Input          byte *outBuf, 
+ \Input          const int width
+ \input          const int height 
+ \input          const int stride for outBuf
+ 
+ \Output         int size output in bytes
+ */
+/*************************************************************************************************F*/
+extern "C" int DeCompressYCoCgDXT5ToRGBA( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride )
+{
+    return DeCompressYCoCgDXT5Blocks( inBuf, outBuf, width, height, stride, 1 );
 }
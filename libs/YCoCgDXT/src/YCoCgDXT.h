@@ -139,6 +139,86 @@ typedef unsigned char   byte;
 /*************************************************************************************************F*/
 int CompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride);
 
+/*F*************************************************************************************************/
+/*!
+ \Function    CompressRGBAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ 
+ \Description  As CompressYCoCgDXT5() but takes RGBA texels, converting them to YCoCg a block at a time.
+ The output is identical to ConvertRGB_ToCoCg_Y8888() followed by CompressYCoCgDXT5().
+ 
+ \Input              const byte *inBuf   Input buffer of the RGBA textel data
+ \Input              const byte *outBuf  Output buffer for the compressed data
+ \Input              int width           in source width 
+ \Input              int height          in source height
+ \Input              int stride          in source in buffer stride in bytes
+ 
+ \Output             int ouput size
+ */
+/*************************************************************************************************F*/
+int CompressRGBAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride);
+
+/*F*************************************************************************************************/
+/*!
+ \Function    CompressBGRAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ 
+ \Description  As CompressRGBAToYCoCgDXT5() but takes BGRA texels.
+ The output is identical to ConvertBGR_ToCoCg_Y8888() followed by CompressYCoCgDXT5().
+ 
+ \Input              const byte *inBuf   Input buffer of the BGRA textel data
+ \Input              const byte *outBuf  Output buffer for the compressed data
+ \Input              int width           in source width 
+ \Input              int height          in source height
+ \Input              int stride          in source in buffer stride in bytes
+ 
+ \Output             int ouput size
+ */
+/*************************************************************************************************F*/
+int CompressBGRAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride);
+
+/*F*************************************************************************************************/
+/*!
+ \Function    CompressRGBAToDXT1( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ \Function    CompressRGBAToDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ 
+ \Description  Real-time DXT1 and DXT5 compression of RGBA texels using the bounding box of each block, after
+ J.M.P. van Waveren's "Real-Time DXT Compression". Much faster than squish and of lower quality.
+ 
+ DXT1 ignores alpha and compresses 4x4 texels into 8 bytes. DXT5 compresses 4x4 texels into 16 bytes.
+ The output is based on rounded up texture sizes on 4 texel boundaries as for CompressYCoCgDXT5().
+ 
+ \Input              const byte *inBuf   Input buffer of the RGBA textel data
+ \Input              const byte *outBuf  Output buffer for the compressed data
+ \Input              int width           in source width 
+ \Input              int height          in source height
+ \Input              int stride          in source in buffer stride in bytes
+ 
+ \Output             int ouput size
+ */
+/*************************************************************************************************F*/
+int CompressRGBAToDXT1( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride );
+
+int CompressRGBAToDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride );
+
+/*F*************************************************************************************************/
+/*!
+ \Function    CompressBGRAToDXT1( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ \Function    CompressBGRAToDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ 
+ \Description  As CompressRGBAToDXT1() and CompressRGBAToDXT5() but take BGRA texels.
+ 
+ \Input              const byte *inBuf   Input buffer of the BGRA textel data
+ \Input              const byte *outBuf  Output buffer for the compressed data
+ \Input              int width           in source width 
+ \Input              int height          in source height
+ \Input              int stride          in source in buffer stride in bytes
+ 
+ \Output             int ouput size
+ */
+/*************************************************************************************************F*/
+int CompressBGRAToDXT1( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride );
+
+int CompressBGRAToDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride );
+
 /*F*************************************************************************************************/
 /*!
  \Function    DeCompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
@@ -180,6 +260,24 @@ int CompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const i
 /*************************************************************************************************F*/
 int DeCompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride );
 
+/*F*************************************************************************************************/
+/*!
+ \Function    DeCompressYCoCgDXT5ToRGBA( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
+ 
+ \Description  As DeCompressYCoCgDXT5() but converts each block to RGBA as it is decoded, with alpha set to 255.
+ The output is identical to DeCompressYCoCgDXT5() followed by ConvertCoCg_Y8888ToRGB_() with alpha set to 255.
+ 
+ \Input          const byte *inBuf
+ \Input          byte *outBuf, 
+ \Input          const int width
+ \input          const int height 
+ \input          const int stride for outBuf
+ 
+ \Output         int size output in bytes
+ */
+/*************************************************************************************************F*/
+int DeCompressYCoCgDXT5ToRGBA( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride );
+
 #ifdef __cplusplus
 }
 #endif
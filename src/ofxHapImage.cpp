@@ -3,515 +3,2391 @@
 #include <hapimage.h>
 #include <hap_old_images.h>
 #include <squish.h>
-#include <YCoCg.h>
 #include <YCoCgDXT.h>
 #if defined(TARGET_WIN32)
 #include <ppl.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+#include <climits>
+#include <fstream>
+#include <limits>
+
+// Must be a multiple of 4
+#define kofxHapImageMTChunkHeight 32
+
+#define kofxHapImageEncodeChunkCount 4
+
+#define kofxHapImageAdaptiveEncodeThreshold 8.0f
+
+namespace ofxHapImagePrivate {
+#if defined(TARGET_OSX) || defined(TARGET_WIN32)
+    class PlatformExecutor : public ofxHapImageExecutor {
+    public:
+        virtual void apply(unsigned int count, const std::function<void(unsigned int)>& work) override
+        {
+#if defined(TARGET_OSX)
+            dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
+                work((unsigned int)index);
+            });
+#else
+            concurrency::parallel_for((unsigned int)0, count, [&](unsigned int i) {
+                work(i);
+            });
+#endif
+        }
+    };
+#endif
+
+    /*
+     Holds an encoded image for as long as an ofxHapImage needs it
+     */
+    class Source {
+    public:
+        virtual ~Source() {};
+        virtual const char *getData() const = 0;
+        virtual unsigned long size() const = 0;
+        // Returns true if the data is that of the file at path, so would be lost by writing the file
+        virtual bool isFile(const std::string& /* path */) const { return false; }
+    };
+
+    class BufferSource : public Source {
+    public:
+        BufferSource(const char *data, unsigned long size) : buffer_(data, size) {}
+        BufferSource(ofBuffer& buffer) { std::swap(buffer_, buffer); }
+        virtual const char *getData() const override { return buffer_.getData(); }
+        virtual unsigned long size() const override { return buffer_.size(); }
+    private:
+        ofBuffer buffer_;
+    };
+
+    /*
+     Identifies a file independent of the path used to reach it
+     */
+    struct FileIdentity {
+        FileIdentity() : device(0), index(0) {}
+        bool operator==(const FileIdentity& other) const { return device == other.device && index == other.index; }
+        uint64_t device;
+        uint64_t index;
+    };
+
+#if defined(TARGET_WIN32)
+    static bool fileIdentity(HANDLE file, FileIdentity& identity)
+    {
+        BY_HANDLE_FILE_INFORMATION info;
+        if (GetFileInformationByHandle(file, &info))
+        {
+            identity.device = info.dwVolumeSerialNumber;
+            identity.index = ((uint64_t)info.nFileIndexHigh << 32) | info.nFileIndexLow;
+            return true;
+        }
+        return false;
+    }
+#else
+    static void fileIdentity(const struct stat& info, FileIdentity& identity)
+    {
+        identity.device = (uint64_t)info.st_dev;
+        identity.index = (uint64_t)info.st_ino;
+    }
+#endif
+
+    // Returns false if the file doesn't exist
+    static bool fileIdentity(const std::string& path, FileIdentity& identity)
+    {
+#if defined(TARGET_WIN32)
+        HANDLE file = CreateFileA(path.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            return false;
+        }
+        bool result = fileIdentity(file, identity);
+        CloseHandle(file);
+        return result;
+#else
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+        {
+            return false;
+        }
+        fileIdentity(info, identity);
+        return true;
+#endif
+    }
+
+    /*
+     A read-only mapping of a file into memory
+     */
+    class MappedFile : public Source {
+    public:
+        // Returns nullptr if the file couldn't be mapped
+        static std::shared_ptr<MappedFile> open(const std::string& filename)
+        {
+            std::string path = ofToDataPath(filename, true);
+            void *data = nullptr;
+            unsigned long size = 0;
+            FileIdentity identity;
+#if defined(TARGET_WIN32)
+            HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file != INVALID_HANDLE_VALUE)
+            {
+                LARGE_INTEGER file_size;
+                if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0 && file_size.QuadPart <= ULONG_MAX)
+                {
+                    HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+                    if (mapping != NULL)
+                    {
+                        // The view keeps the mapping open
+                        data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+                        size = (unsigned long)file_size.QuadPart;
+                        CloseHandle(mapping);
+                    }
+                    fileIdentity(file, identity);
+                }
+                CloseHandle(file);
+            }
+#else
+            int file = ::open(path.c_str(), O_RDONLY);
+            if (file != -1)
+            {
+                struct stat info;
+                if (fstat(file, &info) == 0 && info.st_size > 0 && (unsigned long long)info.st_size <= ULONG_MAX)
+                {
+                    data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+                    if (data == MAP_FAILED)
+                    {
+                        data = nullptr;
+                    }
+                    size = (unsigned long)info.st_size;
+                    fileIdentity(info, identity);
+                }
+                // The mapping remains valid after the file is closed
+                close(file);
+            }
+#endif
+            if (data)
+            {
+                return std::shared_ptr<MappedFile>(new MappedFile(data, size, identity));
+            }
+            return nullptr;
+        }
+
+        virtual ~MappedFile()
+        {
+#if defined(TARGET_WIN32)
+            UnmapViewOfFile(data_);
+#else
+            munmap(data_, size_);
+#endif
+        }
+
+        virtual const char *getData() const override { return static_cast<const char *>(data_); }
+        virtual unsigned long size() const override { return size_; }
+        virtual bool isFile(const std::string& path) const override
+        {
+            FileIdentity identity;
+            return fileIdentity(path, identity) && identity == identity_;
+        }
+    private:
+        MappedFile(void *data, unsigned long size, const FileIdentity& identity) : data_(data), size_(size), identity_(identity) {}
+        void *data_;
+        unsigned long size_;
+        FileIdentity identity_;
+    };
+
+    /*
+     Writes to positions in a file, from any number of threads at once
+     */
+    class Writer {
+    public:
+        virtual ~Writer() {};
+        virtual bool write(const void *data, size_t size, uint64_t offset) = 0;
+        // Discards everything written so far
+        virtual bool clear() = 0;
+    };
+
+    /*
+     Writes to a temporary file beside the destination, which replaces the destination when it is committed, so the
+     destination is never left partly written. The temporary file is removed if it isn't committed.
+     Writes are positional writes, which don't share a file position so need no locking.
+     */
+    class FileWriter : public Writer {
+    public:
+        // Returns nullptr if the file couldn't be created
+        static std::shared_ptr<FileWriter> create(const std::string& path)
+        {
+            static std::atomic<unsigned int> counter(0);
+            for (int attempt = 0; attempt < 100; attempt++)
+            {
+                std::string temporary = path + "." + ofToString(counter++) + ".tmp";
+#if defined(TARGET_WIN32)
+                HANDLE file = CreateFileA(temporary.c_str(), GENERIC_WRITE, 0, NULL, CREATE_NEW, FILE_ATTRIBUTE_NORMAL, NULL);
+                if (file != INVALID_HANDLE_VALUE)
+                {
+                    return std::shared_ptr<FileWriter>(new FileWriter(file, path, temporary));
+                }
+                else if (GetLastError() != ERROR_FILE_EXISTS)
+                {
+                    break;
+                }
+#else
+                int file = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+                if (file != -1)
+                {
+                    return std::shared_ptr<FileWriter>(new FileWriter(file, path, temporary));
+                }
+                else if (errno != EEXIST)
+                {
+                    break;
+                }
+#endif
+            }
+            return nullptr;
+        }
+
+        virtual ~FileWriter()
+        {
+            if (close())
+            {
+#if defined(TARGET_WIN32)
+                DeleteFileA(temporary_.c_str());
+#else
+                unlink(temporary_.c_str());
+#endif
+            }
+        }
+
+        virtual bool write(const void *data, size_t size, uint64_t offset) override
+        {
+            const char *bytes = static_cast<const char *>(data);
+            while (size > 0)
+            {
+#if defined(TARGET_WIN32)
+                DWORD written = 0;
+                OVERLAPPED overlapped = {};
+                overlapped.Offset = (DWORD)(offset & 0xFFFFFFFF);
+                overlapped.OffsetHigh = (DWORD)(offset >> 32);
+                if (!WriteFile(file_, bytes, (DWORD)MIN(size, (size_t)0x40000000), &written, &overlapped) || written == 0)
+                {
+                    return false;
+                }
+#else
+                ssize_t written = pwrite(file_, bytes, size, (off_t)offset);
+                if (written == -1 && errno == EINTR)
+                {
+                    continue;
+                }
+                else if (written <= 0)
+                {
+                    return false;
+                }
+#endif
+                bytes += written;
+                size -= written;
+                offset += written;
+            }
+            return true;
+        }
+
+        virtual bool clear() override
+        {
+#if defined(TARGET_WIN32)
+            LARGE_INTEGER start = {};
+            return SetFilePointerEx(file_, start, NULL, FILE_BEGIN) && SetEndOfFile(file_);
+#else
+            return ftruncate(file_, 0) == 0;
+#endif
+        }
+
+        // Replaces the destination with the file written. Returns false if it couldn't.
+        bool commit()
+        {
+            if (!close())
+            {
+                return false;
+            }
+#if defined(TARGET_WIN32)
+            if (MoveFileExA(temporary_.c_str(), path_.c_str(), MOVEFILE_REPLACE_EXISTING))
+            {
+                return true;
+            }
+            DeleteFileA(temporary_.c_str());
+#else
+            if (rename(temporary_.c_str(), path_.c_str()) == 0)
+            {
+                return true;
+            }
+            unlink(temporary_.c_str());
+#endif
+            return false;
+        }
+    private:
+#if defined(TARGET_WIN32)
+        FileWriter(HANDLE file, const std::string& path, const std::string& temporary) : file_(file), path_(path), temporary_(temporary) {}
+#else
+        FileWriter(int file, const std::string& path, const std::string& temporary) : file_(file), path_(path), temporary_(temporary) {}
+#endif
+        // Returns false if the file was already closed
+        bool close()
+        {
+#if defined(TARGET_WIN32)
+            if (file_ == INVALID_HANDLE_VALUE)
+            {
+                return false;
+            }
+            CloseHandle(file_);
+            file_ = INVALID_HANDLE_VALUE;
+#else
+            if (file_ == -1)
+            {
+                return false;
+            }
+            ::close(file_);
+            file_ = -1;
+#endif
+            return true;
+        }
+#if defined(TARGET_WIN32)
+        HANDLE file_;
+#else
+        int file_;
+#endif
+        std::string path_;
+        std::string temporary_;
+    };
+
+    /*
+     Writes to an ofFile, one write at a time
+     */
+    class StreamWriter : public Writer {
+    public:
+        StreamWriter(ofFile& file) : file_(file), path_(file.getAbsolutePath()) {}
+
+        // Opens the file for writing, emptying it. Returns false if it couldn't be opened.
+        bool open()
+        {
+            return file_.open(path_, ofFile::WriteOnly, true) && file_.is_open();
+        }
+
+        virtual bool write(const void *data, size_t size, uint64_t offset) override
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            file_.seekp(offset);
+            file_.write(static_cast<const char *>(data), size);
+            return file_.good();
+        }
+
+        virtual bool clear() override
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return open();
+        }
+    private:
+        ofFile& file_;
+        std::string path_;
+        std::mutex mutex_;
+    };
+
+    /*
+     Storage for work in flight, reused by later work and freed with the pool
+     */
+    class BufferPool {
+    public:
+        std::vector<unsigned char> acquire(size_t size)
+        {
+            std::vector<unsigned char> buffer;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (!free_.empty())
+                {
+                    buffer = std::move(free_.back());
+                    free_.pop_back();
+                }
+            }
+            if (buffer.size() < size)
+            {
+                buffer.resize(size);
+            }
+            return buffer;
+        }
+
+        void release(std::vector<unsigned char>&& buffer)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            free_.push_back(std::move(buffer));
+        }
+    private:
+        std::mutex mutex_;
+        std::vector<std::vector<unsigned char>> free_;
+    };
+
+    static std::mutex& executorMutex()
+    {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::shared_ptr<ofxHapImageExecutor>& executorStorage()
+    {
+        static std::shared_ptr<ofxHapImageExecutor> executor;
+        return executor;
+    }
+
+    static std::shared_ptr<ofxHapImageExecutor> defaultExecutor()
+    {
+#if defined(TARGET_OSX) || defined(TARGET_WIN32)
+        return std::make_shared<PlatformExecutor>();
+#else
+        return std::make_shared<ofxHapImageThreadPool>();
+#endif
+    }
+
+    static void decodeCallback(HapDecodeWorkFunction function, void *p, unsigned int count, void *info)
+    {
+        static_cast<ofxHapImageExecutor *>(info)->apply(count, [=](unsigned int i) {
+            function(p, i);
+        });
+    }
+
+    static void encodeCallback(HapEncodeWorkFunction function, void *p, unsigned int count, void *info)
+    {
+        static_cast<ofxHapImageExecutor *>(info)->apply(count, [=](unsigned int i) {
+            function(p, i);
+        });
+    }
+
+    /*
+     Returns the number of chunks closest to an ideal count which divide a texture's DXT blocks evenly. The ideal count
+     gives chunks of around target_chunk_bytes and is a multiple of thread_count.
+     */
+    static unsigned int automaticChunkCount(unsigned long texture_bytes, unsigned int format, unsigned long target_chunk_bytes, unsigned int thread_count)
+    {
+        unsigned long block_count = texture_bytes / (format == HapTextureFormat_RGB_DXT1 ? 8 : 16);
+        // The limit imposed by the Hap encoder
+        unsigned long max_count = MIN(block_count, (unsigned long)HapMaxChunkCount);
+        unsigned long ideal = (texture_bytes + target_chunk_bytes - 1) / MAX(target_chunk_bytes, 1UL);
+        if (thread_count == 0)
+        {
+            thread_count = MAX(std::thread::hardware_concurrency(), 1U);
+        }
+        if (ideal > 1)
+        {
+            ideal = ((ideal + thread_count - 1) / thread_count) * thread_count;
+        }
+        ideal = MAX(MIN(ideal, max_count), 1UL);
+        for (unsigned long distance = 0; distance < ideal; distance++)
+        {
+            if (ideal + distance <= max_count && block_count % (ideal + distance) == 0)
+            {
+                return (unsigned int)(ideal + distance);
+            }
+            if (block_count % (ideal - distance) == 0)
+            {
+                return (unsigned int)(ideal - distance);
+            }
+        }
+        return 1;
+    }
+
+    static unsigned int textureFormatForImageType(ofxHapImage::ImageType type)
+    {
+        switch (type) {
+            case ofxHapImage::IMAGE_TYPE_HAP:
+                return HapTextureFormat_RGB_DXT1;
+            case ofxHapImage::IMAGE_TYPE_HAP_ALPHA:
+                return HapTextureFormat_RGBA_DXT5;
+            default:
+                return HapTextureFormat_YCoCg_DXT5;
+        }
+    }
+
+    static bool imageTypeForTextureFormat(unsigned int format, ofxHapImage::ImageType& type)
+    {
+        switch (format) {
+            case HapTextureFormat_RGB_DXT1:
+                type = ofxHapImage::IMAGE_TYPE_HAP;
+                return true;
+            case HapTextureFormat_RGBA_DXT5:
+                type = ofxHapImage::IMAGE_TYPE_HAP_ALPHA;
+                return true;
+            case HapTextureFormat_YCoCg_DXT5:
+                type = ofxHapImage::IMAGE_TYPE_HAP_Q;
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /*
+     Reads from file to extend prefix to at least length bytes, or to the end of the file. Returns false at the end of
+     the file.
+     */
+    static bool readPrefix(std::ifstream& file, std::vector<char>& prefix, unsigned long length)
+    {
+        size_t start = prefix.size();
+        if (length <= start)
+        {
+            return true;
+        }
+        prefix.resize(length);
+        file.read(&prefix[start], length - start);
+        prefix.resize(start + file.gcount());
+        return prefix.size() == length;
+    }
+
+    static int roundUpToMultipleOf4(int n)
+    {
+        if(0 != (n & 3))
+            n = (n + 3) & ~3;
+        return n;
+    }
+
+    /*
+     State reused by every decode on a thread, so decoding a sequence of frames doesn't allocate once the context has
+     grown to fit the frame with the most chunks
+     */
+    class DecodeContext {
+    public:
+        static DecodeContext& forThread()
+        {
+            static thread_local DecodeContext context;
+            return context;
+        }
+
+        void *scratch(size_t size)
+        {
+            if (scratch_.size() < size)
+            {
+                scratch_.resize(size);
+            }
+            return scratch_.data();
+        }
+    private:
+        std::vector<unsigned char> scratch_;
+    };
+
+    static unsigned int bytesPerPixel(ofxHapImage::PixelLayout layout)
+    {
+        switch (layout) {
+            case ofxHapImage::PIXEL_LAYOUT_RGBA:
+            case ofxHapImage::PIXEL_LAYOUT_BGRA:
+                return 4;
+            case ofxHapImage::PIXEL_LAYOUT_RGB:
+            case ofxHapImage::PIXEL_LAYOUT_BGR:
+                return 3;
+            case ofxHapImage::PIXEL_LAYOUT_GREY:
+                return 1;
+            case ofxHapImage::PIXEL_LAYOUT_GREY_ALPHA:
+                return 2;
+            default:
+                return 0;
+        }
+    }
+
+    /*
+     Reads one pixel of layout as RGBA
+     */
+    static inline void readPixel(const unsigned char *in, ofxHapImage::PixelLayout layout, unsigned char *destination)
+    {
+        switch (layout) {
+            case ofxHapImage::PIXEL_LAYOUT_RGBA:
+                memcpy(destination, in, 4);
+                break;
+            case ofxHapImage::PIXEL_LAYOUT_BGRA:
+                destination[0] = in[2];
+                destination[1] = in[1];
+                destination[2] = in[0];
+                destination[3] = in[3];
+                break;
+            case ofxHapImage::PIXEL_LAYOUT_RGB:
+                destination[0] = in[0];
+                destination[1] = in[1];
+                destination[2] = in[2];
+                destination[3] = 255;
+                break;
+            case ofxHapImage::PIXEL_LAYOUT_BGR:
+                destination[0] = in[2];
+                destination[1] = in[1];
+                destination[2] = in[0];
+                destination[3] = 255;
+                break;
+            case ofxHapImage::PIXEL_LAYOUT_GREY:
+                destination[0] = destination[1] = destination[2] = in[0];
+                destination[3] = 255;
+                break;
+            default:
+                destination[0] = destination[1] = destination[2] = in[0];
+                destination[3] = in[1];
+                break;
+        }
+    }
+
+    /*
+     Expands rows of pixels of any layout to RGBA
+     */
+    static void expandToRGBA(const unsigned char *source, size_t source_stride, ofxHapImage::PixelLayout layout, unsigned int width, unsigned int rows, unsigned char *destination)
+    {
+        unsigned int bytes_per_pixel = bytesPerPixel(layout);
+        for (unsigned int y = 0; y < rows; y++, source += source_stride)
+        {
+            const unsigned char *in = source;
+            for (unsigned int x = 0; x < width; x++, in += bytes_per_pixel, destination += 4)
+            {
+                readPixel(in, layout, destination);
+            }
+        }
+    }
+
+    /*
+     The output of recently compressed blocks, keyed by their pixels
+     */
+    class BlockCache {
+    public:
+        struct Entry {
+            unsigned char pixels[16 * 4];
+            unsigned char output[16];
+            bool valid;
+        };
+
+        BlockCache()
+        {
+            for (auto& entry : entries_)
+            {
+                entry.valid = false;
+            }
+        }
+
+        // Returns the entry for pixels, which holds their output if hit is set on return
+        Entry& find(const unsigned char *pixels, bool& hit)
+        {
+            unsigned int hash = 0;
+            for (int i = 0; i < 16; i++)
+            {
+                unsigned int pixel;
+                memcpy(&pixel, pixels + (i * 4), 4);
+                hash += pixel * (0x9E3779B1U + (i << 1));
+            }
+            Entry& entry = entries_[hash >> (32 - kBits)];
+            hit = entry.valid && memcmp(entry.pixels, pixels, sizeof(entry.pixels)) == 0;
+            return entry;
+        }
+    private:
+        static const int kBits = 6;
+        Entry entries_[1 << kBits];
+    };
+
+    /*
+     Encodes rows of pixels of any layout with squish a block at a time, reading each block as RGBA, giving the same
+     output as squish::CompressImage() would for the pixels converted to RGBA. A whole block which repeats a recently
+     compressed one is copied from a cache rather than compressed again. squish already fits a block of one color
+     directly.
+     If adaptive is false, squish_flags selects the fit. If it is true, blocks are encoded with range fit, then encoded
+     again with cluster fit if their mean squared error per channel exceeds threshold.
+     */
+    static void compressBlocks(const unsigned char *pixels, int width, int height, size_t stride, ofxHapImage::PixelLayout layout, unsigned char *dxt, int squish_flags, bool adaptive, float threshold)
+    {
+        int bytes_per_pixel = bytesPerPixel(layout);
+        int channels = (squish_flags & squish::kDxt5) ? 4 : 3;
+        int block_bytes = (squish_flags & squish::kDxt5) ? 16 : 8;
+        int dxt_flags = squish_flags & (squish::kDxt1 | squish::kDxt5);
+        squish::u8 block[16 * 4];
+        squish::u8 decoded[16 * 4];
+        BlockCache cache;
+        for (int y = 0; y < height; y += 4)
+        {
+            for (int x = 0; x < width; x += 4, dxt += block_bytes)
+            {
+                int mask = 0;
+                for (int j = 0; j < 4; j++)
+                {
+                    for (int i = 0; i < 4; i++)
+                    {
+                        if (x + i < width && y + j < height)
+                        {
+                            readPixel(pixels + ((y + j) * stride) + ((x + i) * bytes_per_pixel), layout, &block[(j * 4 + i) * 4]);
+                            mask |= 1 << (j * 4 + i);
+                        }
+                    }
+                }
+                // Partial blocks are rare and their unused pixels are undefined, so they aren't cached
+                BlockCache::Entry *entry = nullptr;
+                if (mask == 0xFFFF)
+                {
+                    bool hit;
+                    entry = &cache.find(block, hit);
+                    if (hit)
+                    {
+                        memcpy(dxt, entry->output, block_bytes);
+                        continue;
+                    }
+                }
+                if (adaptive)
+                {
+                    squish::CompressMasked(block, mask, dxt, dxt_flags | squish::kColourRangeFit);
+                    squish::Decompress(decoded, dxt, dxt_flags);
+                    int error = 0;
+                    int measured = 0;
+                    for (int i = 0; i < 16; i++)
+                    {
+                        // For DXT1 squish makes texels with alpha below 128 transparent, so their color doesn't matter
+                        if ((mask & (1 << i)) && (channels == 4 || block[i * 4 + 3] >= 128))
+                        {
+                            for (int c = 0; c < channels; c++)
+                            {
+                                int difference = block[i * 4 + c] - decoded[i * 4 + c];
+                                error += difference * difference;
+                            }
+                            measured += channels;
+                        }
+                    }
+                    if (error > threshold * measured)
+                    {
+                        squish::CompressMasked(block, mask, dxt, dxt_flags | squish::kColourClusterFit);
+                    }
+                }
+                else
+                {
+                    squish::CompressMasked(block, mask, dxt, squish_flags);
+                }
+                if (entry)
+                {
+                    memcpy(entry->pixels, block, sizeof(entry->pixels));
+                    memcpy(entry->output, dxt, block_bytes);
+                    entry->valid = true;
+                }
+            }
+        }
+    }
+
+    /*
+     The length of the DXT data of width x height pixels, which may exceed what unsigned long holds on some platforms
+     */
+    static uint64_t dxtSize(unsigned int width, unsigned int height, ofxHapImage::ImageType type)
+    {
+        // Hap Alpha and Hap Q use 16 bytes per 4x4 block, Hap half that
+        uint64_t size = (((uint64_t)width + 3) / 4) * (((uint64_t)height + 3) / 4) * 16;
+        if (type == ofxHapImage::IMAGE_TYPE_HAP)
+        {
+            size /= 2;
+        }
+        return size;
+    }
+
+    /*
+     True if DXT data of size bytes can be held in memory and its length passed to the Hap library
+     */
+    static bool dxtSizeIsSupported(uint64_t size)
+    {
+        return size <= std::numeric_limits<unsigned long>::max() && size <= std::numeric_limits<size_t>::max();
+    }
+
+    /*
+     Encodes rows of pixels to DXT in strips of kofxHapImageMTChunkHeight using the executor. rows must be a multiple of
+     4 unless they are the last rows of the image.
+     */
+    static void encodeRows(const unsigned char *pixels, unsigned int width, unsigned int rows, size_t stride, ofxHapImage::PixelLayout layout, ofxHapImage::ImageType type, ofxHapImage::EncodeQuality quality, float threshold, unsigned char *dxt)
+    {
+        int squish_flags;
+        switch (quality) {
+            case ofxHapImage::ENCODE_QUALITY_RANGE_FIT:
+                squish_flags = squish::kColourRangeFit;
+                break;
+            case ofxHapImage::ENCODE_QUALITY_ITERATIVE_CLUSTER_FIT:
+                squish_flags = squish::kColourIterativeClusterFit;
+                break;
+            default:
+                squish_flags = squish::kColourClusterFit;
+                break;
+        }
+        squish_flags |= (type == ofxHapImage::IMAGE_TYPE_HAP ? squish::kDxt1 : squish::kDxt5);
+        unsigned int bytes_per_pixel = bytesPerPixel(layout);
+        unsigned int divisions = rows / kofxHapImageMTChunkHeight;
+        if (rows % kofxHapImageMTChunkHeight != 0)
+        {
+            divisions++;
+        }
+        size_t dxt_bytes_per_division = (size_t)dxtSize(width, kofxHapImageMTChunkHeight, type);
+        BufferPool pool;
+        ofxHapImage::getExecutor()->apply(divisions, [&](unsigned int index) {
+            int chunk_height = MIN(kofxHapImageMTChunkHeight, rows - (kofxHapImageMTChunkHeight * index));
+            const unsigned char *source = pixels + (stride * kofxHapImageMTChunkHeight * index);
+            unsigned char *destination = dxt + (dxt_bytes_per_division * index);
+            if (type == ofxHapImage::IMAGE_TYPE_HAP_Q || quality == ofxHapImage::ENCODE_QUALITY_FAST)
+            {
+                size_t source_stride = stride;
+                bool bgra = layout == ofxHapImage::PIXEL_LAYOUT_BGRA;
+                std::vector<unsigned char> expanded;
+                if (bytes_per_pixel != 4)
+                {
+                    // Expand the strip to RGBA in storage from the pool, rather than converting the whole image
+                    expanded = pool.acquire(width * 4 * chunk_height);
+                    expandToRGBA(source, stride, layout, width, chunk_height, expanded.data());
+                    source = expanded.data();
+                    source_stride = width * 4;
+                }
+                if (type == ofxHapImage::IMAGE_TYPE_HAP_Q)
+                {
+                    // Convert RGBA or BGRA to YCoCg a block at a time and compress to YCoCgDXT
+                    if (bgra)
+                    {
+                        CompressBGRAToYCoCgDXT5(source, destination, width, chunk_height, (int)source_stride);
+                    }
+                    else
+                    {
+                        CompressRGBAToYCoCgDXT5(source, destination, width, chunk_height, (int)source_stride);
+                    }
+                }
+                else if (type == ofxHapImage::IMAGE_TYPE_HAP)
+                {
+                    if (bgra)
+                    {
+                        CompressBGRAToDXT1(source, destination, width, chunk_height, (int)source_stride);
+                    }
+                    else
+                    {
+                        CompressRGBAToDXT1(source, destination, width, chunk_height, (int)source_stride);
+                    }
+                }
+                else
+                {
+                    if (bgra)
+                    {
+                        CompressBGRAToDXT5(source, destination, width, chunk_height, (int)source_stride);
+                    }
+                    else
+                    {
+                        CompressRGBAToDXT5(source, destination, width, chunk_height, (int)source_stride);
+                    }
+                }
+                if (!expanded.empty())
+                {
+                    pool.release(std::move(expanded));
+                }
+            }
+            else
+            {
+                // squish reads each block of pixels as RGBA directly from the source
+                compressBlocks(source,
+                               width,
+                               chunk_height,
+                               stride,
+                               layout,
+                               destination,
+                               squish_flags,
+                               quality == ofxHapImage::ENCODE_QUALITY_ADAPTIVE,
+                               threshold);
+            }
+        });
+    }
+
+    const string YCoCgVertexShader = "void main(void)\
+    {\
+    gl_Position = ftransform();\
+    gl_TexCoord[0] = gl_MultiTexCoord0;\
+    }";
+
+    const string YCoCgFragmentShader = "uniform sampler2D cocgsy_src;\
+    const vec4 offsets = vec4(-0.50196078431373, -0.50196078431373, 0.0, 0.0);\
+    void main()\
+    {\
+    vec4 CoCgSY = texture2D(cocgsy_src, gl_TexCoord[0].xy);\
+    CoCgSY += offsets;\
+    float scale = ( CoCgSY.z * ( 255.0 / 8.0 ) ) + 1.0;\
+    float Co = CoCgSY.x / scale;\
+    float Cg = CoCgSY.y / scale;\
+    float Y = CoCgSY.w;\
+    vec4 rgba = vec4(Y + Co - Cg, Y + Cg, Y - Co - Cg, 1.0);\
+    gl_FragColor = rgba;\
+    }";
+}
+
+std::string ofxHapImage::HapImageFileExtension()
+{
+    return "hpz";
+}
+
+std::string ofxHapImage::imageTypeDescription(ofxHapImage::ImageType type)
+{
+    switch (type) {
+        case IMAGE_TYPE_HAP:
+            return "Hap";
+        case IMAGE_TYPE_HAP_ALPHA:
+            return "Hap Alpha";
+        case IMAGE_TYPE_HAP_Q:
+            return "Hap Q";
+        default:
+            return "Unknown";
+    }
+}
+
+bool ofxHapImage::probe(const std::string& filename, ofxHapImage::Info& info)
+{
+    std::ifstream file(ofToDataPath(filename, true), std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    std::vector<char> prefix;
+    unsigned long length = 4096;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    unsigned long frame_offset = 0;
+    unsigned long frame_size = 0;
+    unsigned int format;
+    unsigned int chunk_count;
+    unsigned int result;
+    bool more = true;
+    do {
+        more = ofxHapImagePrivate::readPrefix(file, prefix, length);
+        result = HapImageReadHeader(prefix.data(), prefix.size(), &width, &height, &frame_offset, &frame_size);
+        length *= 4;
+    } while (result == HapImageResult_Buffer_Too_Small && more);
+    if (result == HapImageResult_Bad_Image)
+    {
+        // Images in the old format have no header, so the whole frame must be read
+        while (ofxHapImagePrivate::readPrefix(file, prefix, length))
+        {
+            length *= 4;
+        }
+        more = false;
+        frame_offset = 0;
+        frame_size = prefix.size();
+        result = HapOldGetFrameDimensions(prefix.data(), prefix.size(), &width, &height);
+    }
+    if (result == HapResult_No_Error)
+    {
+        result = HapGetFrameTextureInfo(prefix.data() + frame_offset, prefix.size() - frame_offset, 0, &format, &chunk_count);
+        while (result == HapResult_Buffer_Too_Small && more)
+        {
+            more = ofxHapImagePrivate::readPrefix(file, prefix, length);
+            length *= 4;
+            result = HapGetFrameTextureInfo(prefix.data() + frame_offset, prefix.size() - frame_offset, 0, &format, &chunk_count);
+        }
+    }
+    if (result == HapResult_No_Error && width != 0 && height != 0
+        && ofxHapImagePrivate::imageTypeForTextureFormat(format, info.type))
+    {
+        info.path = filename;
+        info.width = width;
+        info.height = height;
+        info.chunkCount = chunk_count;
+        info.compressedSize = frame_size;
+        return true;
+    }
+    return false;
+}
+
+std::vector<ofxHapImage::Info> ofxHapImage::probeDirectory(const std::string& path)
+{
+    ofDirectory directory(path);
+    directory.allowExt(HapImageFileExtension());
+    directory.listDir();
+    std::vector<Info> infos(directory.size());
+    std::unique_ptr<bool[]> found(new bool[infos.size()]);
+    getExecutor()->apply((unsigned int)infos.size(), [&](unsigned int index) {
+        found[index] = probe(directory.getPath(index), infos[index]);
+    });
+    std::vector<Info> result;
+    for (size_t i = 0; i < infos.size(); i++)
+    {
+        if (found[i])
+        {
+            result.push_back(infos[i]);
+        }
+    }
+    return result;
+}
+
+void ofxHapImage::setExecutor(std::shared_ptr<ofxHapImageExecutor> executor)
+{
+    std::lock_guard<std::mutex> guard(ofxHapImagePrivate::executorMutex());
+    ofxHapImagePrivate::executorStorage() = executor;
+}
+
+std::shared_ptr<ofxHapImageExecutor> ofxHapImage::getExecutor()
+{
+    std::lock_guard<std::mutex> guard(ofxHapImagePrivate::executorMutex());
+    std::shared_ptr<ofxHapImageExecutor>& executor = ofxHapImagePrivate::executorStorage();
+    if (!executor)
+    {
+        executor = ofxHapImagePrivate::defaultExecutor();
+    }
+    return executor;
+}
+
+void ofxHapImage::setThreadCount(unsigned int count)
+{
+    setExecutor(std::make_shared<ofxHapImageThreadPool>(count));
+}
+
+ofxHapImage::ofxHapImage() :
+texture_needs_update_(true), type_(IMAGE_TYPE_HAP), width_(0), height_(0),
+chunk_count_(kofxHapImageEncodeChunkCount), target_chunk_bytes_(0), decoder_thread_count_(0),
+encode_quality_(ENCODE_QUALITY_CLUSTER_FIT), adaptive_encode_threshold_(kofxHapImageAdaptiveEncodeThreshold),
+lazy_decode_(false), decode_needed_(false), source_dxt_data_(nullptr), frame_offset_(0), frame_size_(0)
+{
+
+}
+
+ofxHapImage::~ofxHapImage()
+{
+
+}
+
+ofxHapImage::ofxHapImage(const std::string& filename) :
+ofxHapImage()
+{
+    loadImage(filename);
+}
+
+ofxHapImage::ofxHapImage(const ofFile& file) :
+ofxHapImage()
+{
+    loadImage(file);
+}
+
+ofxHapImage::ofxHapImage(const ofBuffer& buffer) :
+ofxHapImage()
+{
+    loadImage(buffer);
+}
+
+ofxHapImage::ofxHapImage(const ofImage& image, ofxHapImage::ImageType type) :
+ofxHapImage()
+{
+    loadImage(image, type);
+}
+
+bool ofxHapImage::loadImage(const std::string &filename)
+{
+    if (ofFilePath::getFileExt(filename) == HapImageFileExtension())
+    {
+        std::shared_ptr<ofxHapImagePrivate::Source> source = ofxHapImagePrivate::MappedFile::open(filename);
+        if (!source)
+        {
+            ofBuffer buffer = ofBufferFromFile(filename, true);
+            source = std::make_shared<ofxHapImagePrivate::BufferSource>(buffer);
+        }
+        return readImage(source->getData(), source->size(), source);
+    }
+    else
+    {
+        source_.reset();
+        source_dxt_data_ = nullptr;
+        decode_needed_ = false;
+        dxt_buffer_.clear();
+        return false;
+    }
+}
+
+bool ofxHapImage::loadImage(const ofFile &file)
+{
+    return loadImage(file.getAbsolutePath());
+}
+
+bool ofxHapImage::loadImage(const ofBuffer &buffer)
+{
+    return readImage(buffer.getData(), buffer.size(), nullptr);
+}
+
+bool ofxHapImage::readImage(const char *data, unsigned long size, std::shared_ptr<ofxHapImagePrivate::Source> source)
+{
+    unsigned int width = 0;
+    unsigned int height = 0;
+    const void *frame = nullptr;
+    unsigned long frame_size = 0;
+    HapFrameDescriptor descriptor;
+    bool is_hap_image = true;
+    source_.reset();
+    source_dxt_data_ = nullptr;
+    decode_needed_ = false;
+    unsigned int result = HapImageRead(data, size, &width, &height, &frame, &frame_size);
+    if (result != HapImageResult_No_Error)
+    {
+        // Try the old format to be helpful to anyone with images encoded in it
+        result = HapOldGetFrameDimensions(data, size, &width, &height);
+        frame = data;
+        frame_size = size;
+        is_hap_image = false;
+    }
+    if (result == HapResult_No_Error)
+    {
+        // Parse the frame once for its format, whether it can be used in place, and to decode it
+        result = HapParseFrame(frame, frame_size, &descriptor);
+    }
+    if (result == HapResult_No_Error && descriptor.textureCount != 1)
+    {
+        // Images with more than one texture, such as Hap Q Alpha, aren't supported
+        result = HapResult_Bad_Frame;
+    }
+    if (result == HapResult_No_Error && width != 0 && height != 0)
+    {
+        const void *texture_data = is_hap_image ? descriptor.textures[0].uncompressedData : nullptr;
+        unsigned long texture_size = descriptor.textures[0].compressedBytes;
+        ofxHapImagePrivate::imageTypeForTextureFormat(descriptor.textures[0].textureFormat, type_);
+        width_ = width;
+        height_ = height;
+        if (!ofxHapImagePrivate::dxtSizeIsSupported(dxtSizeForImage()))
+        {
+            result = HapResult_Bad_Frame;
+        }
+        // Images in the old format can't be saved unchanged, so decode them immediately
+        else if (is_hap_image && (lazy_decode_ || (texture_data && texture_size == dxtSizeForImage())))
+        {
+            // Keep the encoded image, copying it if it belongs to the caller
+            if (!source)
+            {
+                source = std::make_shared<ofxHapImagePrivate::BufferSource>(data, size);
+            }
+            source_ = source;
+            if (texture_data && texture_size == dxtSizeForImage())
+            {
+                // The texture is stored uncompressed, so use it where it is
+                source_dxt_data_ = source_->getData() + (static_cast<const char *>(texture_data) - data);
+                dxt_buffer_.clear();
+            }
+            else
+            {
+                frame_offset_ = static_cast<const char *>(frame) - data;
+                frame_size_ = frame_size;
+                decode_needed_ = true;
+                dxt_buffer_.clear();
+            }
+        }
+        else
+        {
+            result = decodeFrame(descriptor);
+        }
+    }
+    if (result == HapResult_No_Error)
+    {
+        texture_needs_update_ = true;
+        return true;
+    }
+    else
+    {
+        width_ = height_ = 0;
+        texture_.clear();
+        dxt_buffer_.clear();
+        source_.reset();
+        source_dxt_data_ = nullptr;
+        decode_needed_ = false;
+        return false;
+    }
+}
+
+uint64_t ofxHapImage::dxtSizeForImage() const
+{
+    return ofxHapImagePrivate::dxtSize(width_, height_, type_);
+}
+
+const char *ofxHapImage::dxtData() const
+{
+    return source_dxt_data_ ? source_dxt_data_ : dxt_buffer_.getData();
+}
+
+uint64_t ofxHapImage::dxtSize() const
+{
+    return source_dxt_data_ ? dxtSizeForImage() : dxt_buffer_.size();
+}
+
+unsigned int ofxHapImage::decodeFrame(const HapFrameDescriptor& frame) const
+{
+    // Images too large for unsigned long aren't loaded
+    unsigned long decompressed_size = (unsigned long)dxtSizeForImage();
+    unsigned long output_buffer_bytes_used;
+
+    if (dxt_buffer_.size() != decompressed_size)
+    {
+        dxt_buffer_.allocate(decompressed_size);
+    }
+    std::shared_ptr<ofxHapImageExecutor> executor = getExecutor();
+    unsigned long scratch_size = HapDecodeScratchLength(&frame, 0);
+    void *scratch = ofxHapImagePrivate::DecodeContext::forThread().scratch(scratch_size);
+    return HapDecodeTextureWithScratch(&frame, 0,
+                                       ofxHapImagePrivate::decodeCallback, executor.get(),
+                                       scratch, scratch_size,
+                                       dxt_buffer_.getData(), dxt_buffer_.size(), &output_buffer_bytes_used);
+}
+
+void ofxHapImage::decode() const
+{
+    if (decode_needed_)
+    {
+        decode_needed_ = false;
+        HapFrameDescriptor descriptor;
+        unsigned int result = HapParseFrame(source_->getData() + frame_offset_, frame_size_, &descriptor);
+        if (result == HapResult_No_Error)
+        {
+            result = decodeFrame(descriptor);
+        }
+        if (result != HapResult_No_Error)
+        {
+            ofLogError("ofxHapImage", "Couldn't decode image");
+            dxt_buffer_.clear();
+        }
+    }
+}
+
+void ofxHapImage::setLazyDecode(bool lazy)
+{
+    lazy_decode_ = lazy;
+}
+
+bool ofxHapImage::getLazyDecode() const
+{
+    return lazy_decode_;
+}
+
+void ofxHapImage::setEncodeQuality(EncodeQuality quality)
+{
+    encode_quality_ = quality;
+}
+
+ofxHapImage::EncodeQuality ofxHapImage::getEncodeQuality() const
+{
+    return encode_quality_;
+}
+
+void ofxHapImage::setAdaptiveEncodeThreshold(float threshold)
+{
+    adaptive_encode_threshold_ = threshold;
+}
+
+float ofxHapImage::getAdaptiveEncodeThreshold() const
+{
+    return adaptive_encode_threshold_;
+}
+
+bool ofxHapImage::loadImage(const ofImage &image, ofxHapImage::ImageType type)
+{
+    return loadImage(image.getPixels(), type);
+}
+
+bool ofxHapImage::loadImage(const ofPixels &pixels, ofxHapImage::ImageType type)
+{
+    PixelLayout layout;
+    switch (pixels.getPixelFormat()) {
+        case OF_PIXELS_RGBA:
+            layout = PIXEL_LAYOUT_RGBA;
+            break;
+        case OF_PIXELS_BGRA:
+            layout = PIXEL_LAYOUT_BGRA;
+            break;
+        case OF_PIXELS_RGB:
+            layout = PIXEL_LAYOUT_RGB;
+            break;
+        case OF_PIXELS_BGR:
+            layout = PIXEL_LAYOUT_BGR;
+            break;
+        case OF_PIXELS_GRAY:
+            layout = PIXEL_LAYOUT_GREY;
+            break;
+        case OF_PIXELS_GRAY_ALPHA:
+            layout = PIXEL_LAYOUT_GREY_ALPHA;
+            break;
+        default:
+            ofLogError("ofxHapImage", "Unsupported pixel format in loadImage()");
+            return false;
+    }
+    return encode(pixels.getData(), pixels.getWidth(), pixels.getHeight(), pixels.getBytesStride(), layout, type);
+}
+
+bool ofxHapImage::loadImage(const unsigned char *pixels, unsigned int width, unsigned int height, size_t stride, ofxHapImage::PixelLayout layout, ofxHapImage::ImageType type)
+{
+    return encode(pixels, width, height, stride, layout, type);
+}
+
+bool ofxHapImage::encode(const unsigned char *pixels, unsigned int width, unsigned int height, size_t stride, ofxHapImage::PixelLayout layout, ofxHapImage::ImageType type)
+{
+    unsigned int bytes_per_pixel = ofxHapImagePrivate::bytesPerPixel(layout);
+    bool result = pixels != nullptr
+        && bytes_per_pixel != 0
+        && stride >= (size_t)width * bytes_per_pixel
+        && (type == IMAGE_TYPE_HAP || type == IMAGE_TYPE_HAP_ALPHA || type == IMAGE_TYPE_HAP_Q)
+        && ofxHapImagePrivate::dxtSizeIsSupported(ofxHapImagePrivate::dxtSize(width, height, type));
+    if (result == true)
+    {
+        source_.reset();
+        source_dxt_data_ = nullptr;
+        decode_needed_ = false;
+        unsigned long dxt_size = (unsigned long)ofxHapImagePrivate::dxtSize(width, height, type);
+        if (dxt_buffer_.size() != dxt_size)
+        {
+            dxt_buffer_.allocate(dxt_size);
+        }
+        ofxHapImagePrivate::encodeRows(pixels,
+                                       width,
+                                       height,
+                                       stride,
+                                       layout,
+                                       type,
+                                       encode_quality_,
+                                       adaptive_encode_threshold_,
+                                       reinterpret_cast<unsigned char *>(dxt_buffer_.getData()));
+        type_ = type;
+        width_ = width;
+        height_ = height;
+        texture_needs_update_ = true;
+    }
+    else
+    {
+        width_ = height_ = 0;
+        texture_.clear();
+        dxt_buffer_.clear();
+        source_.reset();
+        source_dxt_data_ = nullptr;
+        decode_needed_ = false;
+    }
+    return result;
+}
+
+void ofxHapImage::saveImage(ofFile &file)
+{
+    ofxHapImagePrivate::StreamWriter writer(file);
+    detachSource(file.getAbsolutePath());
+    if (!writer.open())
+    {
+        ofLogError("ofxHapImage", "Couldn't open file in saveImage()");
+    }
+    else if (!saveStreamed(writer))
+    {
+        // Leave the file empty rather than partly written
+        writer.clear();
+        ofLogError("ofxHapImage", "Couldn't write file in saveImage()");
+    }
+}
+
+void ofxHapImage::saveImage(const std::string &fileName)
+{
+    std::string path = ofToDataPath(fileName);
+    std::shared_ptr<ofxHapImagePrivate::FileWriter> writer = ofxHapImagePrivate::FileWriter::create(path);
+    if (!writer)
+    {
+        ofLogError("ofxHapImage", "Couldn't open file in saveImage()");
+        return;
+    }
+#if defined(TARGET_WIN32)
+    // The file is replaced rather than written over, but a file which is mapped can't be replaced
+    detachSource(path);
 #endif
+    if (!saveStreamed(*writer) || !writer->commit())
+    {
+        ofLogError("ofxHapImage", "Couldn't write file in saveImage()");
+    }
+}
+
+void ofxHapImage::saveImage(ofBuffer &buffer)
+{
+    /*
+     ofBuffer can't take ownership of memory, so we encode to storage of our own then copy to the buffer
+     */
+    ofxHapImageEncodedData output;
+    if (saveImage(output) == true)
+    {
+        buffer.set(output.getData(), output.size());
+    }
+    else
+    {
+        buffer.clear();
+    }
+}
+
+bool ofxHapImage::saveImage(ofxHapImageEncodedData& output)
+{
+    output.size_ = 0;
+    if (source_)
+    {
+        // The image is unchanged since it was loaded, so save the original encoded image
+        memcpy(output.reserve(source_->size()), source_->getData(), source_->size());
+        output.size_ = source_->size();
+        return true;
+    }
+    unsigned int format = ofxHapImagePrivate::textureFormatForImageType(type_);
+    unsigned long tex_size = (unsigned long)dxtSize();
+    unsigned int chunk_count = saveChunkCount(tex_size, format);
+    // The storage is only written, so it isn't cleared first
+    unsigned long max_size = HapMaxEncodedLength(1, &tex_size, &format, &chunk_count) + 16;
+    char *destination = output.reserve(max_size);
+    unsigned long buffer_used = 0;
+    const void *input = dxtData();
+    unsigned int compressor = HapCompressorSnappy;
+
+    unsigned int result = HapImageWrite(width_, height_, destination, max_size, &buffer_used);
+    if (result == HapImageResult_No_Error)
+    {
+        unsigned long header_used = buffer_used;
+        std::shared_ptr<ofxHapImageExecutor> executor = getExecutor();
+        result = HapEncode(1,
+                           &input,
+                           &tex_size,
+                           &format,
+                           &compressor,
+                           &chunk_count,
+                           ofxHapImagePrivate::encodeCallback,
+                           executor.get(),
+                           destination + buffer_used,
+                           max_size - buffer_used,
+                           &buffer_used);
+        buffer_used += header_used;
+    }
+    if (result == HapResult_No_Error)
+    {
+        output.size_ = buffer_used;
+        return true;
+    }
+    else
+    {
+        return false;
+    }
+}
+
+/*
+ If the image still uses the data of the file at path, copies the data so the file can be written
+ */
+void ofxHapImage::detachSource(const std::string& path)
+{
+    if (source_ && source_->isFile(path))
+    {
+        std::shared_ptr<ofxHapImagePrivate::Source> copy = std::make_shared<ofxHapImagePrivate::BufferSource>(source_->getData(), source_->size());
+        if (source_dxt_data_)
+        {
+            source_dxt_data_ = copy->getData() + (source_dxt_data_ - source_->getData());
+        }
+        source_ = copy;
+    }
+}
+
+bool ofxHapImage::saveStreamed(ofxHapImagePrivate::Writer& writer)
+{
+    if (source_)
+    {
+        // Write the original encoded image without copying it first
+        return writer.write(source_->getData(), source_->size(), 0);
+    }
+    unsigned int format = ofxHapImagePrivate::textureFormatForImageType(type_);
+    const char *input = dxtData();
+    unsigned long tex_size = (unsigned long)dxtSize();
+    if (input == nullptr || tex_size == 0)
+    {
+        return false;
+    }
+    // As HapEncode() does, divide the texture equally on DXT block boundaries
+    unsigned int chunk_count = saveChunkCount(tex_size, format);
+    unsigned long chunk_size = tex_size / chunk_count;
 
-// Must be a multiple of 4
-#define kofxHapImageMTChunkHeight 32
+    /*
+     Write the headers first to reserve their space, then write them again once every chunk's size is known
+     */
+    std::vector<char> header(16 + HapStreamHeaderLength(tex_size, chunk_count));
+    unsigned long image_header_length = 0;
+    unsigned long frame_header_length = 0;
+    if (HapImageWrite(width_, height_, header.data(), header.size(), &image_header_length) != HapImageResult_No_Error
+        || HapEncodeStreamHeader(tex_size, format, chunk_count, nullptr, nullptr,
+                                 header.data() + image_header_length, header.size() - image_header_length,
+                                 &frame_header_length, nullptr) != HapResult_No_Error
+        || !writer.write(header.data(), image_header_length + frame_header_length, 0))
+    {
+        return false;
+    }
+    uint64_t data_start = image_header_length + frame_header_length;
 
-#define kofxHapImageEncodeChunkCount 4
+    /*
+     Chunks are written in chunk order, so the file is the same as one saved by HapEncode(). Each task claims the next
+     chunk in order, rather than the executor dividing the chunks between tasks, so a compressed chunk is only held
+     until the few chunks before it being compressed at the same time are done. Whichever task completes a run of
+     chunks writes them, without waiting for the chunks still being compressed.
+     */
+    ofxHapImagePrivate::BufferPool pool;
+    std::vector<std::vector<unsigned char>> compressed(chunk_count);
+    std::vector<unsigned int> compressors(chunk_count);
+    std::vector<unsigned long> sizes(chunk_count);
+    std::vector<bool> ready(chunk_count, false);
+    std::mutex mutex;
+    unsigned int next = 0;
+    uint64_t data_length = 0;
+    std::atomic<unsigned int> claimed(0);
+    std::atomic<bool> failed(false);
+    unsigned int tasks = MIN(MAX(std::thread::hardware_concurrency(), 1U), chunk_count);
+    getExecutor()->apply(tasks, [&](unsigned int) {
+        unsigned int i;
+        while ((i = claimed++) < chunk_count && !failed)
+        {
+            const char *chunk = input + (chunk_size * i);
+            unsigned long max_length = HapMaxEncodedChunkLength(chunk_size);
+            std::vector<unsigned char> buffer = pool.acquire(max_length);
+            unsigned long length = 0;
+            unsigned int compressor = HapCompressorNone;
+            if (HapEncodeChunk(chunk, chunk_size, HapCompressorSnappy, buffer.data(), max_length, &length, &compressor) != HapResult_No_Error)
+            {
+                failed = true;
+                return;
+            }
+            if (compressor != HapCompressorSnappy)
+            {
+                // The chunk is written from the input
+                pool.release(std::move(buffer));
+            }
+            unsigned int first;
+            unsigned int last;
+            uint64_t offset;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                compressed[i] = std::move(buffer);
+                compressors[i] = compressor;
+                sizes[i] = length;
+                ready[i] = true;
+                first = next;
+                offset = data_start + data_length;
+                while (next < chunk_count && ready[next])
+                {
+                    data_length += sizes[next];
+                    next++;
+                }
+                last = next;
+                // Lengths within the frame are stored in four bytes
+                if (data_start + data_length > UINT32_MAX)
+                {
+                    failed = true;
+                    return;
+                }
+            }
+            for (unsigned int j = first; j < last && !failed; j++)
+            {
+                const void *data = compressors[j] == HapCompressorSnappy ? (const void *)compressed[j].data() : (const void *)(input + (chunk_size * j));
+                if (!writer.write(data, sizes[j], offset))
+                {
+                    failed = true;
+                }
+                offset += sizes[j];
+                if (compressors[j] == HapCompressorSnappy)
+                {
+                    pool.release(std::move(compressed[j]));
+                }
+            }
+        }
+    });
+    if (failed)
+    {
+        return false;
+    }
 
-namespace ofxHapImagePrivate {
-    static void decodeCallback(HapDecodeWorkFunction function, void *p, unsigned int count, void *info)
+    // Fill in the chunk tables and the frame length
+    unsigned int stored_compressor = HapCompressorSnappy;
+    if (HapEncodeStreamHeader(tex_size, format, chunk_count, compressors.data(), sizes.data(),
+                              header.data() + image_header_length, header.size() - image_header_length,
+                              &frame_header_length, &stored_compressor) != HapResult_No_Error)
     {
-#if defined(TARGET_OSX)
-        dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
-            function(p, (unsigned int)index);
-        });
-#elif defined(TARGET_WIN32)
-        concurrency::parallel_for((unsigned int)0, count, [&](unsigned int i) {
-            function(p, i);
-        });
-#else
-        // TODO: multi-threaded on Linux
-        for (unsigned int i = 0; i < count; i++) {
-            function(p, i);
-        }
-#endif
+        return false;
+    }
+    if (stored_compressor == HapCompressorNone)
+    {
+        // Compression saved no space so, as HapEncode() does, store the texture uncompressed in place of the chunks
+        return writer.clear()
+            && writer.write(header.data(), image_header_length + frame_header_length, 0)
+            && writer.write(input, tex_size, image_header_length + frame_header_length);
     }
+    return writer.write(header.data() + image_header_length, frame_header_length, image_header_length);
+}
 
-    static int roundUpToMultipleOf4(int n)
+unsigned int ofxHapImage::saveChunkCount(unsigned long tex_size, unsigned int format) const
+{
+    unsigned int count = chunk_count_;
+    if (count == 0)
     {
-        if(0 != (n & 3))
-            n = (n + 3) & ~3;
-        return n;
+        count = ofxHapImagePrivate::automaticChunkCount(tex_size, format, target_chunk_bytes_, decoder_thread_count_);
     }
+    return HapLimitedChunkCount(tex_size, format, count);
+}
 
-    const string YCoCgVertexShader = "void main(void)\
-    {\
-    gl_Position = ftransform();\
-    gl_TexCoord[0] = gl_MultiTexCoord0;\
-    }";
+void ofxHapImage::setChunkCount(unsigned int count)
+{
+    chunk_count_ = MAX(count, 1U);
+}
 
-    const string YCoCgFragmentShader = "uniform sampler2D cocgsy_src;\
-    const vec4 offsets = vec4(-0.50196078431373, -0.50196078431373, 0.0, 0.0);\
-    void main()\
-    {\
-    vec4 CoCgSY = texture2D(cocgsy_src, gl_TexCoord[0].xy);\
-    CoCgSY += offsets;\
-    float scale = ( CoCgSY.z * ( 255.0 / 8.0 ) ) + 1.0;\
-    float Co = CoCgSY.x / scale;\
-    float Cg = CoCgSY.y / scale;\
-    float Y = CoCgSY.w;\
-    vec4 rgba = vec4(Y + Co - Cg, Y + Cg, Y - Co - Cg, 1.0);\
-    gl_FragColor = rgba;\
-    }";
+void ofxHapImage::setAutomaticChunkCount(unsigned long targetChunkBytes, unsigned int decoderThreadCount)
+{
+    chunk_count_ = 0;
+    target_chunk_bytes_ = targetChunkBytes;
+    decoder_thread_count_ = decoderThreadCount;
 }
 
-std::string ofxHapImage::HapImageFileExtension()
+float ofxHapImage::getWidth() const
 {
-    return "hpz";
+    return width_;
 }
 
-std::string ofxHapImage::imageTypeDescription(ofxHapImage::ImageType type)
+float ofxHapImage::getHeight() const
 {
-    switch (type) {
-        case IMAGE_TYPE_HAP:
-            return "Hap";
-        case IMAGE_TYPE_HAP_ALPHA:
-            return "Hap Alpha";
-        case IMAGE_TYPE_HAP_Q:
-            return "Hap Q";
-        default:
-            return "Unknown";
-    }
+    return height_;
 }
 
-ofxHapImage::ofxHapImage() :
-texture_needs_update_(true), type_(IMAGE_TYPE_HAP), width_(0), height_(0)
+ofxHapImage::ImageType ofxHapImage::getImageType()
 {
+    return type_;
+}
 
+ofTexture& ofxHapImage::getTexture()
+{
+    prepareTexture();
+    return texture_;
 }
 
-ofxHapImage::~ofxHapImage()
+const ofTexture& ofxHapImage::getTexture() const
+{
+    prepareTexture();
+    return texture_;
+}
+
+void ofxHapImage::prepareTexture() const
 {
+    decode();
+    if (texture_needs_update_ && dxtSize() > 0 && width_ > 0 && height_ > 0)
+    {
+        /*
+         Prepare our texture for DXT upload
+         */
+        GLint internal_type = (type_ == IMAGE_TYPE_HAP ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+
+        if (texture_.getWidth() != width_
+            || texture_.getHeight() != height_
+            || texture_.getTextureData().glInternalFormat != internal_type)
+        {
+            ofTextureData texData;
+            texData.width = width_;
+            texData.height = height_;
+            texData.textureTarget = GL_TEXTURE_2D;
+            texData.glInternalFormat = internal_type;
+            texture_.allocate(texData, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV);
+        }
+
+#if defined(TARGET_OSX)
+        texture_.bind();
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_STORAGE_HINT_APPLE , GL_STORAGE_SHARED_APPLE);
+        texture_.unbind();
+#endif
+
+        glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
+
+        texture_.bind();
+
+
+#if defined(TARGET_OSX)
+        glTextureRangeAPPLE(GL_TEXTURE_2D, (GLsizei)dxtSize(), const_cast<char *>(dxtData()));
+        glPixelStorei(GL_UNPACK_CLIENT_STORAGE_APPLE, GL_TRUE);
+#endif
+
+        glCompressedTexSubImage2D(GL_TEXTURE_2D,
+                                  0,
+                                  0,
+                                  0,
+                                  width_,
+                                  height_,
+                                  internal_type,
+                                  (GLsizei)dxtSize(),
+                                  dxtData());
+        texture_.unbind();
+
+        glPopClientAttrib();
 
+        texture_needs_update_ = false;
+    }
 }
 
-ofxHapImage::ofxHapImage(const std::string& filename)
+ofShader& ofxHapImage::getShader() const
 {
-    loadImage(filename);
+    if (!shader_.isLoaded())
+    {
+        bool success = shader_.setupShaderFromSource(GL_VERTEX_SHADER, ofxHapImagePrivate::YCoCgVertexShader);
+        if (success)
+        {
+            success = shader_.setupShaderFromSource(GL_FRAGMENT_SHADER, ofxHapImagePrivate::YCoCgFragmentShader);
+        }
+        if (success)
+        {
+            success = shader_.linkProgram();
+        }
+    }
+    return shader_;
 }
 
-ofxHapImage::ofxHapImage(const ofFile& file)
+void ofxHapImage::draw(float x, float y) const
 {
-    loadImage(file);
+    draw(x, y, getWidth(), getHeight());
 }
 
-ofxHapImage::ofxHapImage(const ofBuffer& buffer)
+void ofxHapImage::draw(float x, float y, float w, float h) const
 {
-    loadImage(buffer);
+    if (getTexture().isAllocated())
+    {
+        if (type_ == IMAGE_TYPE_HAP_Q)
+        {
+            getShader().begin();
+        }
+        getTexture().draw(x, y, w, h);
+        if (type_ == IMAGE_TYPE_HAP_Q)
+        {
+            getShader().end();
+        }
+    }
 }
 
-ofxHapImage::ofxHapImage(ofImage& image, ofxHapImage::ImageType type)
+bool ofxHapImage::isLoaded() const
 {
-    loadImage(image, type);
+    return dxtSize() > 0 || decode_needed_;
 }
 
-bool ofxHapImage::loadImage(const std::string &filename)
+bool ofxHapImage::getPixels(ofPixels& pixels) const
 {
-    if (ofFilePath::getFileExt(filename) == HapImageFileExtension())
+    if (!isLoaded())
     {
-        ofBuffer buffer = ofBufferFromFile(filename, true);
-        return loadImage(buffer);
+        return false;
     }
-    else
+    pixels.allocate(width_, height_, OF_PIXELS_RGBA);
+    return getPixels(pixels.getData(), width_ * 4);
+}
+
+bool ofxHapImage::getPixels(unsigned char *destination, size_t stride) const
+{
+    decode();
+    if (dxtSize() == 0 || width_ == 0 || height_ == 0)
     {
-        dxt_buffer_.clear();
         return false;
     }
+    const char *dxt = dxtData();
+    unsigned int blocks_across = ofxHapImagePrivate::roundUpToMultipleOf4(width_) / 4;
+    unsigned int bytes_per_block = (type_ == IMAGE_TYPE_HAP ? 8 : 16);
+    unsigned int divisions = (height_ + kofxHapImageMTChunkHeight - 1) / kofxHapImageMTChunkHeight;
+
+    getExecutor()->apply(divisions, [&](unsigned int index) {
+        unsigned int top = index * kofxHapImageMTChunkHeight;
+        unsigned int rows = MIN(kofxHapImageMTChunkHeight, height_ - top);
+        const char *source = dxt + ((top / 4) * blocks_across * bytes_per_block);
+        unsigned char *strip = destination + (top * stride);
+        if (type_ == IMAGE_TYPE_HAP_Q)
+        {
+            // Decode and convert each block straight to RGBA
+            DeCompressYCoCgDXT5ToRGBA(reinterpret_cast<const byte *>(source), strip, width_, rows, (int)stride);
+        }
+        else
+        {
+            int flags = (type_ == IMAGE_TYPE_HAP ? squish::kDxt1 : squish::kDxt5);
+            squish::u8 block[16 * 4];
+            for (unsigned int y = 0; y < rows; y += 4)
+            {
+                unsigned int block_height = MIN(4U, rows - y);
+                for (unsigned int x = 0; x < blocks_across; x++)
+                {
+                    unsigned int block_width = MIN(4U, width_ - (x * 4));
+                    squish::Decompress(block, source, flags);
+                    source += bytes_per_block;
+                    for (unsigned int row = 0; row < block_height; row++)
+                    {
+                        memcpy(strip + ((y + row) * stride) + (x * 16), block + (row * 16), block_width * 4);
+                    }
+                }
+            }
+        }
+    });
+    return true;
 }
 
-bool ofxHapImage::loadImage(const ofFile &file)
+ofxHapImageEncodedData::ofxHapImageEncodedData() :
+capacity_(0), size_(0)
 {
-    return loadImage(file.getAbsolutePath());
+
 }
 
-bool ofxHapImage::loadImage(const ofBuffer &buffer)
+const char *ofxHapImageEncodedData::getData() const
 {
-    // TODO: we could postpone this until we need the dxt data
-    // so that loadImage() -> saveImage() doesn't do a needless decode/encode cycle
-    unsigned int count;
-    unsigned int width = 0;
-    unsigned int height = 0;
-    unsigned int dimensions_valid;
-    unsigned int format;
-    const void *frame = nullptr;
-    unsigned long frame_size = 0;
-    unsigned int result = HapImageRead(buffer.getData(), buffer.size(), &width, &height, &frame, &frame_size);
-    if (result != HapImageResult_No_Error)
+    return data_.get();
+}
+
+size_t ofxHapImageEncodedData::size() const
+{
+    return size_;
+}
+
+void ofxHapImageEncodedData::clear()
+{
+    data_.reset();
+    capacity_ = size_ = 0;
+}
+
+char *ofxHapImageEncodedData::reserve(size_t size)
+{
+    if (capacity_ < size)
     {
-        // Try the old format to be helpful to anyone with images encoded in it
-        result = HapOldGetFrameDimensions(buffer.getData(), buffer.size(), &width, &height);
-        frame = buffer.getData();
-        frame_size = buffer.size();
+        // new char[] leaves the storage uninitialised, unlike resizing a vector
+        data_.reset(new char[size]);
+        capacity_ = size;
     }
-    if (result == HapResult_No_Error)
+    return data_.get();
+}
+
+void ofxHapImageSerialExecutor::apply(unsigned int count, const std::function<void(unsigned int)>& work)
+{
+    for (unsigned int i = 0; i < count; i++)
     {
-        // TODO: deal with count != 1 at least by error
-        result = HapGetFrameTextureCount(frame, frame_size, &count);
+        work(i);
     }
-    if (result == HapResult_No_Error)
+}
+
+ofxHapImageFunctionExecutor::ofxHapImageFunctionExecutor(Function function) :
+function_(function)
+{
+
+}
+
+void ofxHapImageFunctionExecutor::apply(unsigned int count, const std::function<void(unsigned int)>& work)
+{
+    function_(count, work);
+}
+
+/*
+ Each job is divided into one contiguous range of indices per participating thread. A thread works through its own range
+ first, then steals remaining indices from the other ranges. Jobs are reused, so a job isn't finished until every worker
+ which took part has finished with it.
+ */
+struct ofxHapImageThreadPool::Job {
+    struct Range {
+        std::atomic<unsigned int> next;
+        unsigned int end;
+    };
+
+    Job(unsigned int capacity) :
+    work(nullptr), ranges(new Range[capacity]), capacity(capacity), slots(0), remaining(0), users(0), busy(false)
     {
-        result = HapGetFrameTextureFormat(frame, frame_size, 0, &format);
+
     }
-    if (result == HapResult_No_Error && width != 0 && height != 0)
+
+    void reset(unsigned int count, unsigned int slots, const std::function<void(unsigned int)>& work)
     {
-        switch (format) {
-            case HapTextureFormat_RGB_DXT1:
-                type_ = IMAGE_TYPE_HAP;
-                break;
-            case HapTextureFormat_RGBA_DXT5:
-                type_ = IMAGE_TYPE_HAP_ALPHA;
-                break;
-            case HapTextureFormat_YCoCg_DXT5:
-                type_ = IMAGE_TYPE_HAP_Q;
-                break;
-            default:
-                break;
+        if (slots > capacity)
+        {
+            ranges.reset(new Range[slots]);
+            capacity = slots;
         }
-        width_ = width;
-        height_ = height;
-        long decompressed_size = ofxHapImagePrivate::roundUpToMultipleOf4(width) * ofxHapImagePrivate::roundUpToMultipleOf4(height);
-        unsigned long output_buffer_bytes_used;
+        this->work = &work;
+        this->slots = slots;
+        for (unsigned int i = 0; i < slots; i++)
+        {
+            ranges[i].next = (unsigned int)(((unsigned long long)count * i) / slots);
+            ranges[i].end = (unsigned int)(((unsigned long long)count * (i + 1)) / slots);
+        }
+        remaining = count;
+    }
 
-        if (format == HapTextureFormat_RGB_DXT1)
+    void run(unsigned int home)
+    {
+        for (unsigned int i = 0; i < slots; i++)
         {
-            decompressed_size /= 2;
+            Range& range = ranges[(home + i) % slots];
+            while (range.next.load(std::memory_order_relaxed) < range.end)
+            {
+                unsigned int index = range.next.fetch_add(1);
+                if (index >= range.end)
+                {
+                    break;
+                }
+                (*work)(index);
+                if (remaining.fetch_sub(1) == 1)
+                {
+                    std::lock_guard<std::mutex> guard(mutex);
+                    done.notify_all();
+                }
+            }
         }
-        if (dxt_buffer_.size() != decompressed_size)
+    }
+
+    void join()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        users++;
+    }
+
+    void leave()
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        if (--users == 0)
         {
-            dxt_buffer_.allocate(decompressed_size);
+            done.notify_all();
         }
-        result = HapDecode(frame, frame_size, 0, ofxHapImagePrivate::decodeCallback, NULL, dxt_buffer_.getData(), dxt_buffer_.size(), &output_buffer_bytes_used, &format);
     }
-    if (result == HapResult_No_Error)
+
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this] { return remaining.load() == 0 && users == 0; });
+    }
+
+    const std::function<void(unsigned int)> *work;
+    std::unique_ptr<Range[]> ranges;
+    unsigned int capacity;
+    unsigned int slots;
+    std::atomic<unsigned int> remaining;
+    // Workers using the job, guarded by mutex
+    unsigned int users;
+    // Only used by the thread which owns the job
+    bool busy;
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+ofxHapImageThreadPool::ofxHapImageThreadPool(unsigned int threadCount) :
+stop_(false)
+{
+    if (threadCount == 0)
     {
-        texture_needs_update_ = true;
-        return true;
+        threadCount = std::max(std::thread::hardware_concurrency(), 1U);
     }
-    else
+    // The thread calling apply() does work, so start one fewer
+    for (unsigned int i = 1; i < threadCount; i++)
     {
-        width_ = height_ = 0;
-        texture_.clear();
-        dxt_buffer_.clear();
-        return false;
+        threads_.push_back(std::thread(&ofxHapImageThreadPool::workerMain, this, i));
     }
 }
 
-bool ofxHapImage::loadImage(ofImage &image, ofxHapImage::ImageType type)
+ofxHapImageThreadPool::~ofxHapImageThreadPool()
 {
-    ofImageType input_type = image.getPixels().getImageType();
-    if (input_type != OF_IMAGE_COLOR_ALPHA)
     {
-        image = ofImage(image); // TODO: most efficient up/down-sample mechanism
-        image.setImageType(OF_IMAGE_COLOR_ALPHA);
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
     }
-    // Initial calculation gives largest size, for Hap Alpha and Hap Q
-    long dxt_size = ofxHapImagePrivate::roundUpToMultipleOf4(image.getWidth()) * ofxHapImagePrivate::roundUpToMultipleOf4(image.getHeight());
-    int squish_flags = squish::kColourClusterFit;
-    bool result = true;
-    switch (type) {
-        case IMAGE_TYPE_HAP:
-            dxt_size /= 2;
-            squish_flags |= squish::kDxt1;
-            break;
-        case IMAGE_TYPE_HAP_ALPHA:
-            squish_flags |= squish::kDxt5;
-            break;
-        case IMAGE_TYPE_HAP_Q:
-            break;
-        default:
-            result = false;
-            break;
+    condition_.notify_all();
+    for (std::thread& thread : threads_)
+    {
+        thread.join();
     }
-    if (result == true)
+}
+
+unsigned int ofxHapImageThreadPool::getThreadCount() const
+{
+    return (unsigned int)threads_.size() + 1;
+}
+
+void ofxHapImageThreadPool::apply(unsigned int count, const std::function<void(unsigned int)>& work)
+{
+    if (threads_.empty() || count < 2)
     {
-        if (dxt_buffer_.size() != dxt_size)
+        for (unsigned int i = 0; i < count; i++)
         {
-            dxt_buffer_.allocate(dxt_size);
+            work(i);
         }
-        unsigned int divisions = image.getHeight() / kofxHapImageMTChunkHeight;
-        if ((int)image.getHeight() % kofxHapImageMTChunkHeight != 0)
+        return;
+    }
+    // Each thread reuses its own job, so steady work doesn't allocate. A nested call finds it busy and makes its own.
+    static thread_local std::unique_ptr<Job> spare;
+    std::unique_ptr<Job> nested;
+    Job *job;
+    if (!spare)
+    {
+        spare.reset(new Job(getThreadCount()));
+    }
+    if (!spare->busy)
+    {
+        job = spare.get();
+    }
+    else
+    {
+        nested.reset(new Job(getThreadCount()));
+        job = nested.get();
+    }
+    job->busy = true;
+    job->reset(count, std::min(count, getThreadCount()), work);
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        jobs_.push_back(job);
+    }
+    condition_.notify_all();
+    job->run(0);
+    {
+        // Once we return from run() there is nothing left to claim, so stop offering the job to workers
+        std::lock_guard<std::mutex> guard(mutex_);
+        std::vector<Job *>::iterator it = std::find(jobs_.begin(), jobs_.end(), job);
+        if (it != jobs_.end())
         {
-            divisions++;
+            jobs_.erase(it);
         }
-        ofPixels pixels = image.getPixels();
-        size_t dxt_bytes_per_division = ofxHapImagePrivate::roundUpToMultipleOf4(image.getWidth()) * kofxHapImageMTChunkHeight;
-        if (type == IMAGE_TYPE_HAP)
+    }
+    job->wait();
+    job->busy = false;
+}
+
+void ofxHapImageThreadPool::workerMain(unsigned int worker)
+{
+    while (true)
+    {
+        Job *job;
         {
-            dxt_bytes_per_division /= 2;
-        }
-#if defined(TARGET_OSX)
-        dispatch_apply(divisions, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
-#elif defined(TARGET_WIN32)
-        concurrency::parallel_for((unsigned int)0, divisions, [&](unsigned int index) {
-#else
-        for (unsigned int index = 0; index < divisions; index++) {
-#endif
-            int chunk_height = MIN(kofxHapImageMTChunkHeight, image.getHeight() - (kofxHapImageMTChunkHeight * index));
-            if (type == IMAGE_TYPE_HAP_Q)
-            {
-                // First convert RGBA to YCoCg
-                std::vector<uint8_t> ycocg(chunk_height * image.getWidth() * 4);
-                ConvertRGB_ToCoCg_Y8888(static_cast<const uint8_t *>(&pixels[pixels.getPixelIndex(0, index * kofxHapImageMTChunkHeight)]),
-                                        &ycocg[0],
-                                        image.getWidth(),
-                                        chunk_height,
-                                        image.getWidth() * 4,
-                                        image.getWidth() * 4,
-                                        0);
-                // Convert YCoCg to YCoCgDXT
-                CompressYCoCgDXT5(static_cast<byte *>(&ycocg[0]),
-                                  reinterpret_cast<byte *>(dxt_buffer_.getData() + (dxt_bytes_per_division * index)),
-                                  image.getWidth(),
-                                  chunk_height,
-                                  image.getWidth() * 4);
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+            if (stop_)
+            {
+                return;
             }
-            else
+            // Joining while the job is offered keeps it from being reused until we leave it
+            job = jobs_.front();
+            job->join();
+        }
+        job->run(worker % job->slots);
+        {
+            std::lock_guard<std::mutex> guard(mutex_);
+            std::vector<Job *>::iterator it = std::find(jobs_.begin(), jobs_.end(), job);
+            if (it != jobs_.end())
             {
-                squish::CompressImage(&pixels[pixels.getPixelIndex(0, index * kofxHapImageMTChunkHeight)],
-                                      image.getWidth(),
-                                      chunk_height,
-                                      dxt_buffer_.getData() + (dxt_bytes_per_division * index),
-                                      squish_flags);
+                jobs_.erase(it);
             }
-#if defined(TARGET_LINUX)
         }
-#else
-        });
-#endif
-        type_ = type;
-        width_ = image.getWidth();
-        height_ = image.getHeight();
-        texture_needs_update_ = true;
-    }
-    else
-    {
-        width_ = height_ = 0;
-        texture_.clear();
-        dxt_buffer_.clear();
+        job->leave();
     }
-    return result;
 }
 
-void ofxHapImage::saveImage(ofFile &file)
+ofxHapImageStreamEncoder::ofxHapImageStreamEncoder() :
+compressed_capacity_(0), image_header_length_(0), data_length_(0), type_(ofxHapImage::IMAGE_TYPE_HAP),
+layout_(ofxHapImage::PIXEL_LAYOUT_RGBA), encode_quality_(ofxHapImage::ENCODE_QUALITY_CLUSTER_FIT),
+adaptive_encode_threshold_(kofxHapImageAdaptiveEncodeThreshold), width_(0), height_(0), strip_height_(0), rows_added_(0)
 {
-    file.changeMode(ofFile::ReadWrite, true);
-    ofBuffer buffer;
-    saveImage(buffer);
-    file << buffer;
+
 }
 
-void ofxHapImage::saveImage(const std::string &fileName)
+ofxHapImageStreamEncoder::~ofxHapImageStreamEncoder()
+{
+
+}
+
+void ofxHapImageStreamEncoder::setEncodeQuality(ofxHapImage::EncodeQuality quality)
+{
+    encode_quality_ = quality;
+}
+
+ofxHapImage::EncodeQuality ofxHapImageStreamEncoder::getEncodeQuality() const
+{
+    return encode_quality_;
+}
+
+void ofxHapImageStreamEncoder::setAdaptiveEncodeThreshold(float threshold)
+{
+    adaptive_encode_threshold_ = threshold;
+}
+
+float ofxHapImageStreamEncoder::getAdaptiveEncodeThreshold() const
+{
+    return adaptive_encode_threshold_;
+}
+
+bool ofxHapImageStreamEncoder::begin(const std::string& fileName, unsigned int width, unsigned int height, unsigned int stripHeight, ofxHapImage::PixelLayout layout, ofxHapImage::ImageType type)
 {
-    std::ofstream file_out;
-    file_out.open(ofToDataPath(fileName).c_str(), std::ios::binary);
-    if (file_out.is_open())
+    writer_.reset();
+    rows_added_ = 0;
+    data_length_ = 0;
+    if (width == 0
+        || height == 0
+        || stripHeight == 0
+        || stripHeight % 4 != 0
+        || ofxHapImagePrivate::bytesPerPixel(layout) == 0
+        || (type != ofxHapImage::IMAGE_TYPE_HAP && type != ofxHapImage::IMAGE_TYPE_HAP_ALPHA && type != ofxHapImage::IMAGE_TYPE_HAP_Q))
     {
-        std::vector<char> destination;
-        if (saveImage(destination))
-        {
-            file_out.write(&destination[0], destination.size());
-        }
-        file_out.close();
+        ofLogError("ofxHapImage", "Bad arguments to ofxHapImageStreamEncoder::begin()");
+        return false;
     }
-    else
+    width_ = width;
+    height_ = height;
+    strip_height_ = MIN(stripHeight, (unsigned int)ofxHapImagePrivate::roundUpToMultipleOf4(height));
+    layout_ = layout;
+    type_ = type;
+
+    uint64_t dxt_size = ofxHapImagePrivate::dxtSize(width_, height_, type_);
+    if (!ofxHapImagePrivate::dxtSizeIsSupported(dxt_size))
     {
-        ofLogError("ofxHapImage", "Couldn't open file in saveImage()");
+        ofLogError("ofxHapImage", "Image too large in ofxHapImageStreamEncoder::begin()");
+        return false;
     }
-}
 
-void ofxHapImage::saveImage(ofBuffer &buffer)
-{
+    // One chunk per strip
+    unsigned int chunk_count = (height + strip_height_ - 1) / strip_height_;
+    unsigned long header_length = HapStreamHeaderLength((unsigned long)dxt_size, chunk_count);
+    if (header_length == 0)
+    {
+        ofLogError("ofxHapImage", "Too many strips in ofxHapImageStreamEncoder::begin()");
+        return false;
+    }
+    chunk_compressors_.assign(chunk_count, HapCompressorNone);
+    chunk_sizes_.assign(chunk_count, 0);
+
     /*
-     ofBuffer doesn't allow a buffer to be shrunk, so we have to encode to a vector then
-     copy to the buffer afterwards
+     Write the headers first to reserve their space, then write them again in finish() once every chunk is known
      */
-    std::vector<char> destination;
-    if (saveImage(destination) == true)
+    header_.resize(16 + header_length);
+    unsigned long frame_header_length = 0;
+    if (HapImageWrite(width_, height_, header_.data(), header_.size(), &image_header_length_) != HapImageResult_No_Error
+        || HapEncodeStreamHeader((unsigned long)dxt_size, ofxHapImagePrivate::textureFormatForImageType(type_), chunk_count,
+                                 nullptr, nullptr,
+                                 header_.data() + image_header_length_, header_.size() - image_header_length_,
+                                 &frame_header_length, nullptr) != HapResult_No_Error)
     {
-        buffer.set(&destination[0], destination.size());
+        ofLogError("ofxHapImage", "Couldn't create header in ofxHapImageStreamEncoder::begin()");
+        return false;
     }
-    else
+    header_.resize(image_header_length_ + frame_header_length);
+
+    writer_ = ofxHapImagePrivate::FileWriter::create(ofToDataPath(fileName));
+    if (!writer_ || !writer_->write(header_.data(), header_.size(), 0))
     {
-        buffer.clear();
+        fail("Couldn't open file in ofxHapImageStreamEncoder::begin()");
+        return false;
     }
+
+    // Storage for one strip, reused for every strip
+    unsigned long strip_dxt_size = (unsigned long)ofxHapImagePrivate::dxtSize(width_, strip_height_, type_);
+    dxt_.reset(new unsigned char[strip_dxt_size]);
+    compressed_capacity_ = HapMaxEncodedChunkLength(strip_dxt_size);
+    compressed_.reset(new char[compressed_capacity_]);
+    return true;
 }
 
-bool ofxHapImage::saveImage(std::vector<char>& destination)
+bool ofxHapImageStreamEncoder::addRows(const unsigned char *pixels, unsigned int rows, size_t stride)
 {
-    unsigned int format;
-    switch (type_) {
-        case IMAGE_TYPE_HAP:
-            format = HapTextureFormat_RGB_DXT1;
-            break;
-        case IMAGE_TYPE_HAP_ALPHA:
-            format = HapTextureFormat_RGBA_DXT5;
-            break;
-        case IMAGE_TYPE_HAP_Q:
-            format = HapTextureFormat_YCoCg_DXT5;
-            break;
-        default:
-            break;
+    if (!writer_)
+    {
+        ofLogError("ofxHapImage", "ofxHapImageStreamEncoder::addRows() called without begin()");
+        return false;
     }
-    unsigned long tex_size = dxt_buffer_.size();
-    unsigned int chunk_count = kofxHapImageEncodeChunkCount;
-    destination.resize(HapMaxEncodedLength(1, &tex_size, &format, &chunk_count) + 16);
-    unsigned long buffer_used = 0;
-    const void *input = dxt_buffer_.getData();
-    unsigned int compressor = HapCompressorSnappy;
+    if (pixels == nullptr
+        || rows != MIN(strip_height_, height_ - rows_added_)
+        || stride < (size_t)width_ * ofxHapImagePrivate::bytesPerPixel(layout_))
+    {
+        fail("Bad arguments to ofxHapImageStreamEncoder::addRows()");
+        return false;
+    }
+    unsigned int chunk = rows_added_ / strip_height_;
+    unsigned long dxt_size = (unsigned long)ofxHapImagePrivate::dxtSize(width_, rows, type_);
+    ofxHapImagePrivate::encodeRows(pixels, width_, rows, stride, layout_, type_, encode_quality_, adaptive_encode_threshold_, dxt_.get());
 
-    unsigned int result = HapImageWrite(width_, height_, &destination[0], destination.size(), &buffer_used);
-    if (result == HapImageResult_No_Error)
+    unsigned long length = 0;
+    if (HapEncodeChunk(dxt_.get(), dxt_size, HapCompressorSnappy, compressed_.get(), compressed_capacity_, &length, &chunk_compressors_[chunk]) != HapResult_No_Error)
     {
-        unsigned long header_used = buffer_used;
-        result = HapEncode(1,
-                           &input,
-                           &tex_size,
-                           &format,
-                           &compressor,
-                           &chunk_count,
-                           &destination[buffer_used],
-                           destination.size() - buffer_used,
-                           &buffer_used);
-        buffer_used += header_used;
+        fail("Couldn't compress in ofxHapImageStreamEncoder::addRows()");
+        return false;
     }
-    if (result == HapResult_No_Error)
+    // Lengths within the frame are stored in four bytes
+    if (data_length_ + length > UINT32_MAX - header_.size())
     {
-        destination.resize(buffer_used);
-        return true;
+        fail("Image exceeds the 4 GB limit of a Hap frame in ofxHapImageStreamEncoder::addRows()");
+        return false;
     }
-    else
+    const void *data = chunk_compressors_[chunk] == HapCompressorSnappy ? (const void *)compressed_.get() : (const void *)dxt_.get();
+    if (!writer_->write(data, length, header_.size() + data_length_))
     {
-        destination.clear();
+        fail("Couldn't write file in ofxHapImageStreamEncoder::addRows()");
         return false;
     }
+    chunk_sizes_[chunk] = length;
+    data_length_ += length;
+    rows_added_ += rows;
+    return true;
 }
 
-float ofxHapImage::getWidth() const
+unsigned int ofxHapImageStreamEncoder::getRowsAdded() const
 {
-    return width_;
+    return rows_added_;
 }
 
-float ofxHapImage::getHeight() const
+bool ofxHapImageStreamEncoder::finish()
 {
-    return height_;
+    if (!writer_ || rows_added_ != height_)
+    {
+        ofLogError("ofxHapImage", "ofxHapImageStreamEncoder::finish() called before every row was added");
+        return false;
+    }
+    // Fill in the chunk tables and the frame length
+    unsigned long frame_header_length = 0;
+    bool result = HapEncodeStreamHeader((unsigned long)ofxHapImagePrivate::dxtSize(width_, height_, type_), ofxHapImagePrivate::textureFormatForImageType(type_), (unsigned int)chunk_sizes_.size(),
+                                        chunk_compressors_.data(), chunk_sizes_.data(),
+                                        header_.data() + image_header_length_, header_.size() - image_header_length_,
+                                        &frame_header_length, nullptr) == HapResult_No_Error
+        && writer_->write(header_.data() + image_header_length_, frame_header_length, image_header_length_)
+        && writer_->commit();
+    writer_.reset();
+    dxt_.reset();
+    compressed_.reset();
+    if (!result)
+    {
+        ofLogError("ofxHapImage", "Couldn't write file in ofxHapImageStreamEncoder::finish()");
+    }
+    return result;
 }
 
-ofxHapImage::ImageType ofxHapImage::getImageType()
+void ofxHapImageStreamEncoder::fail(const std::string& message)
 {
-    return type_;
+    ofLogError("ofxHapImage", message);
+    writer_.reset();
+    dxt_.reset();
+    compressed_.reset();
 }
 
-ofTexture& ofxHapImage::getTexture()
+ofxHapImageLoader::Request::Request(const std::string& filename) :
+filename_(filename), image_(new ofxHapImage()), state_(STATE_PENDING)
 {
-    prepareTexture();
-    return texture_;
+
 }
 
-const ofTexture& ofxHapImage::getTexture() const
+ofxHapImageLoader::Request::State ofxHapImageLoader::Request::getState() const
 {
-    prepareTexture();
-    return texture_;
+    std::lock_guard<std::mutex> guard(mutex_);
+    return state_;
 }
 
-void ofxHapImage::prepareTexture() const
+bool ofxHapImageLoader::Request::isReady() const
 {
-    if (texture_needs_update_ && dxt_buffer_.size() > 0 && width_ > 0 && height_ > 0)
-    {
-        /*
-         Prepare our texture for DXT upload
-         */
-        GLint internal_type = (type_ == IMAGE_TYPE_HAP ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT);
+    return getState() != STATE_PENDING;
+}
 
-        if (texture_.getWidth() != width_
-            || texture_.getHeight() != height_
-            || texture_.getTextureData().glInternalFormat != internal_type)
+void ofxHapImageLoader::Request::wait() const
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    condition_.wait(lock, [this] { return state_ != STATE_PENDING; });
+}
+
+void ofxHapImageLoader::Request::cancel()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        // A loaded image is left alone, as references to it may already have been taken through getImage()
+        if (state_ != STATE_PENDING)
         {
-            ofTextureData texData;
-            texData.width = width_;
-            texData.height = height_;
-            texData.textureTarget = GL_TEXTURE_2D;
-            texData.glInternalFormat = internal_type;
-            texture_.allocate(texData, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV);
+            return;
         }
+        state_ = STATE_CANCELLED;
+    }
+    condition_.notify_all();
+}
 
-#if defined(TARGET_OSX)
-        texture_.bind();
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_STORAGE_HINT_APPLE , GL_STORAGE_SHARED_APPLE);
-        texture_.unbind();
-#endif
-
-        glPushClientAttrib(GL_CLIENT_PIXEL_STORE_BIT);
-
-        texture_.bind();
-
-
-#if defined(TARGET_OSX)
-        glTextureRangeAPPLE(GL_TEXTURE_2D, dxt_buffer_.size(), const_cast<char *>(dxt_buffer_.getData()));
-        glPixelStorei(GL_UNPACK_CLIENT_STORAGE_APPLE, GL_TRUE);
-#endif
+const std::string& ofxHapImageLoader::Request::getFilename() const
+{
+    return filename_;
+}
 
-        glCompressedTexSubImage2D(GL_TEXTURE_2D,
-                                  0,
-                                  0,
-                                  0,
-                                  width_,
-                                  height_,
-                                  internal_type,
-                                  dxt_buffer_.size(),
-                                  dxt_buffer_.getData());
-        texture_.unbind();
+ofxHapImage& ofxHapImageLoader::Request::getImage()
+{
+    return *image_;
+}
 
-        glPopClientAttrib();
+ofxHapImageLoader::ofxHapImageLoader(unsigned int maxPendingRequests, unsigned int threadCount) :
+max_pending_(std::max(maxPendingRequests, 1U)), stop_(false)
+{
+    for (unsigned int i = 0; i < std::max(threadCount, 1U); i++)
+    {
+        threads_.push_back(std::thread(&ofxHapImageLoader::workerMain, this));
+    }
+}
 
-        texture_needs_update_ = false;
+ofxHapImageLoader::~ofxHapImageLoader()
+{
+    std::deque<std::shared_ptr<Request>> requests;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stop_ = true;
+        std::swap(requests, requests_);
+    }
+    condition_.notify_all();
+    for (std::shared_ptr<Request>& request : requests)
+    {
+        request->cancel();
+    }
+    for (std::thread& thread : threads_)
+    {
+        thread.join();
     }
 }
 
-ofShader& ofxHapImage::getShader() const
+std::shared_ptr<ofxHapImageLoader::Request> ofxHapImageLoader::load(const std::string& filename)
 {
-    if (!shader_.isLoaded())
+    std::shared_ptr<Request> request;
     {
-        bool success = shader_.setupShaderFromSource(GL_VERTEX_SHADER, ofxHapImagePrivate::YCoCgVertexShader);
-        if (success)
-        {
-            success = shader_.setupShaderFromSource(GL_FRAGMENT_SHADER, ofxHapImagePrivate::YCoCgFragmentShader);
-        }
-        if (success)
+        std::lock_guard<std::mutex> guard(mutex_);
+        purgeCancelled();
+        if (pendingCount() >= max_pending_)
         {
-            success = shader_.linkProgram();
+            return nullptr;
         }
+        request = std::shared_ptr<Request>(new Request(filename));
+        requests_.push_back(request);
     }
-    return shader_;
+    condition_.notify_one();
+    return request;
 }
 
-void ofxHapImage::draw(float x, float y) const
+unsigned int ofxHapImageLoader::getPendingRequestCount() const
 {
-    draw(x, y, getWidth(), getHeight());
+    std::lock_guard<std::mutex> guard(mutex_);
+    return pendingCount();
 }
 
-void ofxHapImage::draw(float x, float y, float w, float h) const
+unsigned int ofxHapImageLoader::pendingCount() const
 {
-    if (getTexture().isAllocated())
+    // Requests cancelled while being loaded are left out, though their loads continue until they finish
+    auto pending = [](const std::shared_ptr<Request>& request) {
+        return request->getState() != Request::STATE_CANCELLED;
+    };
+    return (unsigned int)(std::count_if(requests_.begin(), requests_.end(), pending) + std::count_if(active_.begin(), active_.end(), pending));
+}
+
+void ofxHapImageLoader::purgeCancelled()
+{
+    // Cancelled requests which haven't started are dropped here rather than by cancel(), which doesn't know the loader
+    requests_.erase(std::remove_if(requests_.begin(), requests_.end(), [](const std::shared_ptr<Request>& request) {
+        return request->getState() == Request::STATE_CANCELLED;
+    }), requests_.end());
+}
+
+void ofxHapImageLoader::workerMain()
+{
+    while (true)
     {
-        if (type_ == IMAGE_TYPE_HAP_Q)
+        std::shared_ptr<Request> request;
         {
-            getShader().begin();
+            std::unique_lock<std::mutex> lock(mutex_);
+            condition_.wait(lock, [this] { return stop_ || !requests_.empty(); });
+            if (stop_)
+            {
+                return;
+            }
+            request = requests_.front();
+            requests_.pop_front();
+            active_.push_back(request);
         }
-        getTexture().draw(x, y, w, h);
-        if (type_ == IMAGE_TYPE_HAP_Q)
+        std::unique_ptr<ofxHapImage> image(new ofxHapImage());
+        bool loaded = false;
+        if (request->getState() == Request::STATE_PENDING)
         {
-            getShader().end();
+            // Load into a separate image so the request's image is never touched while it could be cancelled
+            image->setLazyDecode(false);
+            loaded = image->loadImage(request->filename_);
+            // An uncompressed texture is used from the mapped file, so read it into memory here rather than during
+            // upload on the GL thread
+            image->detachSource(ofToDataPath(request->filename_, true));
+        }
+        {
+            // Leave the limit before the request is seen to complete
+            std::lock_guard<std::mutex> guard(mutex_);
+            active_.erase(std::find(active_.begin(), active_.end(), request));
         }
+        {
+            std::lock_guard<std::mutex> guard(request->mutex_);
+            if (request->state_ == Request::STATE_PENDING)
+            {
+                if (loaded)
+                {
+                    std::swap(request->image_, image);
+                }
+                request->state_ = loaded ? Request::STATE_LOADED : Request::STATE_FAILED;
+            }
+        }
+        request->condition_.notify_all();
     }
 }
-
-bool ofxHapImage::isLoaded() const
-{
-    return dxt_buffer_.size() > 0;
-}
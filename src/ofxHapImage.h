@@ -1,8 +1,119 @@
 #pragma once
 #include "ofMain.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
 
 // TODO: ofImage from ofxHapImage
 
+namespace ofxHapImagePrivate {
+    class Source;
+    class Writer;
+    class FileWriter;
+}
+
+struct HapFrameDescriptor;
+
+/*
+ An executor performs the multithreaded parts of encoding and decoding. Set one with ofxHapImage::setExecutor() to control
+ which threads ofxHapImage uses.
+ */
+class ofxHapImageExecutor {
+public:
+    virtual ~ofxHapImageExecutor() {};
+
+    /*
+     Must call work once for every index from 0 to count - 1, and must not return until all the calls have completed.
+     Calls may be made concurrently from any number of threads.
+     */
+    virtual void apply(unsigned int count, const std::function<void(unsigned int)>& work) = 0;
+};
+
+/*
+ An executor which performs all work on the calling thread
+ */
+class ofxHapImageSerialExecutor : public ofxHapImageExecutor {
+public:
+    virtual void apply(unsigned int count, const std::function<void(unsigned int)>& work) override;
+};
+
+/*
+ An executor which hands work to an existing thread pool or job system. function is called in place of apply() and has
+ the same obligations.
+ */
+class ofxHapImageFunctionExecutor : public ofxHapImageExecutor {
+public:
+    typedef std::function<void(unsigned int count, const std::function<void(unsigned int)>& work)> Function;
+
+    ofxHapImageFunctionExecutor(Function function);
+
+    virtual void apply(unsigned int count, const std::function<void(unsigned int)>& work) override;
+
+private:
+    Function function_;
+};
+
+/*
+ An executor with a persistent pool of worker threads. Work submitted with apply() is divided between the threads, and
+ threads which run out of work steal it from the others.
+ */
+class ofxHapImageThreadPool : public ofxHapImageExecutor {
+public:
+    /*
+     threadCount is the number of threads which perform work, including the thread calling apply().
+     If threadCount is 0 one thread per core is used.
+     */
+    ofxHapImageThreadPool(unsigned int threadCount = 0);
+    ~ofxHapImageThreadPool();
+
+    unsigned int getThreadCount() const;
+
+    /*
+     Calls work once for every index from 0 to count - 1 and returns when all the calls have completed.
+     The calling thread performs work too, so apply() may safely be called from within work.
+     */
+    virtual void apply(unsigned int count, const std::function<void(unsigned int)>& work) override;
+
+private:
+    struct Job;
+    void workerMain(unsigned int worker);
+    std::vector<std::thread> threads_;
+    std::vector<Job *> jobs_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_;
+};
+
+/*
+ Storage for an encoded Hap image. Keep one between calls to ofxHapImage::saveImage() to save many images without
+ allocating or clearing memory for each. The storage grows to fit the largest image saved into it.
+ */
+class ofxHapImageEncodedData {
+public:
+    ofxHapImageEncodedData();
+
+    const char *getData() const;
+
+    size_t size() const;
+
+    /*
+     Releases the storage
+     */
+    void clear();
+
+private:
+    friend class ofxHapImage;
+    // Returns storage for at least size bytes, with undefined contents
+    char *reserve(size_t size);
+    std::unique_ptr<char[]> data_;
+    size_t capacity_;
+    size_t size_;
+};
+
 class ofxHapImage : public ofAbstractImage {
 public:
     enum ImageType {
@@ -11,6 +122,26 @@ public:
         IMAGE_TYPE_HAP_Q
     };
 
+    enum EncodeQuality {
+        ENCODE_QUALITY_FAST,
+        ENCODE_QUALITY_RANGE_FIT,
+        ENCODE_QUALITY_ADAPTIVE,
+        ENCODE_QUALITY_CLUSTER_FIT,
+        ENCODE_QUALITY_ITERATIVE_CLUSTER_FIT
+    };
+
+    /*
+     The order of 8-bit channels in each pixel of a raw pixel buffer
+     */
+    enum PixelLayout {
+        PIXEL_LAYOUT_RGBA,
+        PIXEL_LAYOUT_BGRA,
+        PIXEL_LAYOUT_RGB,
+        PIXEL_LAYOUT_BGR,
+        PIXEL_LAYOUT_GREY,
+        PIXEL_LAYOUT_GREY_ALPHA
+    };
+
     /*
      The file extension for Hap Images
      */
@@ -21,11 +152,51 @@ public:
      */
     static std::string imageTypeDescription(ImageType type);
 
+    /*
+     Information about an image, read by probe() without loading the image
+     */
+    struct Info {
+        std::string path;
+        ImageType type;
+        unsigned int width;
+        unsigned int height;
+        unsigned int chunkCount;
+        // The size in bytes of the compressed frame
+        unsigned long compressedSize;
+    };
+
+    /*
+     Reads information about an image from the start of its file, usually only its first 4 KB. Returns false if the file
+     isn't a Hap image.
+     */
+    static bool probe(const std::string& filename, Info& info);
+
+    /*
+     Probes every Hap image in a directory, several at a time using the executor. Files which aren't Hap images are
+     omitted from the result.
+     */
+    static std::vector<Info> probeDirectory(const std::string& path);
+
+    /*
+     Sets the executor used by all images for multithreaded encoding and decoding. Pass nullptr to restore the default,
+     which uses Grand Central Dispatch on macOS, the Parallel Patterns Library on Windows and an ofxHapImageThreadPool
+     elsewhere.
+     */
+    static void setExecutor(std::shared_ptr<ofxHapImageExecutor> executor);
+
+    static std::shared_ptr<ofxHapImageExecutor> getExecutor();
+
+    /*
+     Sets the executor to an ofxHapImageThreadPool with count threads. If count is 0 one thread per core is used.
+     */
+    static void setThreadCount(unsigned int count);
+
     ofxHapImage();
     virtual ~ofxHapImage();
 
     /*
-     Load an existing Hap image
+     Load an existing Hap image. Files are memory-mapped where possible, and a texture stored without compression is
+     used directly from the mapping rather than being copied.
      */
     ofxHapImage(const ofFile& file);
 
@@ -36,10 +207,11 @@ public:
     /*
      Create a new Hap image
      */
-    ofxHapImage(ofImage& image, ofxHapImage::ImageType type);
+    ofxHapImage(const ofImage& image, ofxHapImage::ImageType type);
 
     /*
-     Load an existing Hap image
+     Load an existing Hap image. Files are memory-mapped where possible, and a texture stored without compression is
+     used directly from the mapping rather than being copied.
      */
     bool loadImage(const ofFile& file);
     
@@ -48,9 +220,54 @@ public:
     bool loadImage(const ofBuffer& buffer);
 
     /*
-     Create a  new Hap image
+     Lazy decoding. When enabled, loading an existing image reads only enough to discover its dimensions and type, and
+     the image is decoded when it is first drawn or its texture is used.
+     An image loaded this way keeps its encoded data, and saveImage() writes that data unchanged rather than encoding
+     the image again.
+     Disabled by default.
+     */
+    void setLazyDecode(bool lazy);
+
+    bool getLazyDecode() const;
+
+    /*
+     The trade between speed and quality when creating IMAGE_TYPE_HAP and IMAGE_TYPE_HAP_ALPHA images.
+     ENCODE_QUALITY_FAST fits each block to the bounds of its colors, and is fast enough to encode video frames as
+     they are captured. ENCODE_QUALITY_FAST ignores alpha for IMAGE_TYPE_HAP, where the others make pixels with alpha
+     below 128 transparent black.
+     ENCODE_QUALITY_RANGE_FIT, ENCODE_QUALITY_CLUSTER_FIT and ENCODE_QUALITY_ITERATIVE_CLUSTER_FIT use squish's methods
+     of the same names, each slower and of higher quality than the one before.
+     ENCODE_QUALITY_ADAPTIVE uses range fit, then encodes again with cluster fit only those blocks whose error exceeds
+     the adaptive threshold, giving close to the quality of cluster fit in a fraction of the time.
+     IMAGE_TYPE_HAP_Q images are always encoded the same way.
+     ENCODE_QUALITY_CLUSTER_FIT by default.
+     */
+    void setEncodeQuality(EncodeQuality quality);
+
+    EncodeQuality getEncodeQuality() const;
+
+    /*
+     The mean squared error per channel of a block above which ENCODE_QUALITY_ADAPTIVE uses cluster fit. Lower values
+     improve quality and take longer. 8 by default.
+     */
+    void setAdaptiveEncodeThreshold(float threshold);
+
+    float getAdaptiveEncodeThreshold() const;
+
+    /*
+     Create a new Hap image. Grey, grey and alpha, RGB, BGR, RGBA and BGRA pixels are accepted. The pixels are read in
+     place and converted to RGBA a block at a time as they are encoded, except that ENCODE_QUALITY_FAST and Hap Q
+     expand layouts other than RGBA and BGRA a strip at a time.
      */
-    bool loadImage(ofImage& image, ofxHapImage::ImageType type);
+    bool loadImage(const ofImage& image, ofxHapImage::ImageType type);
+
+    bool loadImage(const ofPixels& pixels, ofxHapImage::ImageType type);
+
+    /*
+     Create a new Hap image from a raw pixel buffer, without copying it. stride is the distance in bytes from the start
+     of one row to the start of the next, and need not be a multiple of 4 nor the pixels aligned.
+     */
+    bool loadImage(const unsigned char *pixels, unsigned int width, unsigned int height, size_t stride, ofxHapImage::PixelLayout layout, ofxHapImage::ImageType type);
 
     /*
      Is loaded
@@ -58,7 +275,21 @@ public:
     bool isLoaded() const;
 
     /*
-     Save a Hap image
+     Decodes the image to 8-bit RGBA pixels on the CPU, without using GL
+     */
+    bool getPixels(ofPixels& pixels) const;
+
+    /*
+     Decodes the image to 8-bit RGBA pixels in destination, which has stride bytes between the starts of rows and must
+     hold at least getHeight() rows of getWidth() pixels
+     */
+    bool getPixels(unsigned char *destination, size_t stride) const;
+
+    /*
+     Save a Hap image. Saving to a file compresses the image a chunk at a time on the executor, and writes each chunk
+     once the chunks before it are written, so only the chunks in flight are held in memory. The file is identical to
+     the image saved to a buffer. Saving to fileName writes a temporary file beside it, which replaces fileName once it
+     is complete. Saving to file empties it first, and empties it again on failure.
      */
     void saveImage(const std::string& fileName);
 
@@ -66,6 +297,27 @@ public:
 
     void saveImage(ofFile& file);
 
+    /*
+     Save a Hap image to storage which can be reused for later saves. Returns false and leaves output empty on failure.
+     */
+    bool saveImage(ofxHapImageEncodedData& output);
+
+    /*
+     Chunking for saved images. The chunks of an image can be decoded in parallel, so more chunks permit more decoder
+     threads, at the cost of a little overhead per chunk. By default images are saved in 4 chunks.
+
+     setChunkCount() sets a fixed chunk count.
+
+     setAutomaticChunkCount() chooses a count for each image from its size: enough chunks that each is around
+     targetChunkBytes, rounded up to a multiple of decoderThreadCount (if 0, the number of cores on this machine).
+
+     Chunks must divide an image evenly on DXT block boundaries, so the count used may differ slightly from the count
+     requested.
+     */
+    void setChunkCount(unsigned int count);
+
+    void setAutomaticChunkCount(unsigned long targetChunkBytes = 256 * 1024, unsigned int decoderThreadCount = 0);
+
     /*
      Drawing
      */
@@ -94,13 +346,187 @@ public:
     virtual bool isUsingTexture() const override { return true; };
 
 private:
-    bool saveImage(std::vector<char>& destination);
+    friend class ofxHapImageLoader;
+    bool readImage(const char *data, unsigned long size, std::shared_ptr<ofxHapImagePrivate::Source> source);
+    bool encode(const unsigned char *pixels, unsigned int width, unsigned int height, size_t stride, ofxHapImage::PixelLayout layout, ofxHapImage::ImageType type);
+    void detachSource(const std::string& path);
+    bool saveStreamed(ofxHapImagePrivate::Writer& writer);
+    unsigned int saveChunkCount(unsigned long tex_size, unsigned int format) const;
+    uint64_t dxtSizeForImage() const;
+    const char *dxtData() const;
+    uint64_t dxtSize() const;
+    unsigned int decodeFrame(const HapFrameDescriptor& frame) const;
+    void decode() const;
     void prepareTexture() const;
-    ofBuffer dxt_buffer_;
+    mutable ofBuffer dxt_buffer_;
     mutable ofTexture texture_;
     mutable ofShader shader_;
     mutable bool texture_needs_update_;
     ofxHapImage::ImageType type_;
     unsigned int width_;
     unsigned int height_;
+    unsigned int chunk_count_;
+    unsigned long target_chunk_bytes_;
+    unsigned int decoder_thread_count_;
+    EncodeQuality encode_quality_;
+    float adaptive_encode_threshold_;
+    bool lazy_decode_;
+    mutable bool decode_needed_;
+    std::shared_ptr<ofxHapImagePrivate::Source> source_;
+    const char *source_dxt_data_;
+    unsigned long frame_offset_;
+    unsigned long frame_size_;
+};
+
+/*
+ Encodes a Hap image straight to a file from rows of pixels supplied a strip at a time, for images too large to hold in
+ memory as a whole. Each strip is encoded and written as one chunk of the image before the next is accepted, so memory
+ use is proportional to the strip height rather than the height of the image.
+ Hap frames store their lengths in four bytes, which limits the encoded image to 4 GB, after second-stage compression.
+ addRows() fails if the image grows beyond that.
+ */
+class ofxHapImageStreamEncoder {
+public:
+    ofxHapImageStreamEncoder();
+
+    /*
+     An image which hasn't been finished is discarded
+     */
+    ~ofxHapImageStreamEncoder();
+
+    /*
+     As for ofxHapImage, set before begin()
+     */
+    void setEncodeQuality(ofxHapImage::EncodeQuality quality);
+
+    ofxHapImage::EncodeQuality getEncodeQuality() const;
+
+    void setAdaptiveEncodeThreshold(float threshold);
+
+    float getAdaptiveEncodeThreshold() const;
+
+    /*
+     Begins an image of width x height pixels of layout, to be saved as fileName when it is finished. Every strip but
+     the last must be stripHeight rows, which must be a multiple of 4.
+     */
+    bool begin(const std::string& fileName, unsigned int width, unsigned int height, unsigned int stripHeight, ofxHapImage::PixelLayout layout, ofxHapImage::ImageType type);
+
+    /*
+     Encodes and writes the next strip. rows must be the strip height, or the number of rows remaining for the last
+     strip. stride is as for ofxHapImage::loadImage(). The pixels aren't used once this returns. On failure the image
+     can't be finished.
+     */
+    bool addRows(const unsigned char *pixels, unsigned int rows, size_t stride);
+
+    unsigned int getRowsAdded() const;
+
+    /*
+     Completes the image once every row has been added, and replaces fileName with it
+     */
+    bool finish();
+
+private:
+    void fail(const std::string& message);
+    std::shared_ptr<ofxHapImagePrivate::FileWriter> writer_;
+    std::unique_ptr<unsigned char[]> dxt_;
+    std::unique_ptr<char[]> compressed_;
+    unsigned long compressed_capacity_;
+    std::vector<char> header_;
+    unsigned long image_header_length_;
+    std::vector<unsigned int> chunk_compressors_;
+    std::vector<unsigned long> chunk_sizes_;
+    uint64_t data_length_;
+    ofxHapImage::ImageType type_;
+    ofxHapImage::PixelLayout layout_;
+    ofxHapImage::EncodeQuality encode_quality_;
+    float adaptive_encode_threshold_;
+    unsigned int width_;
+    unsigned int height_;
+    unsigned int strip_height_;
+    unsigned int rows_added_;
+};
+
+/*
+ Loads Hap images on background threads. Reading and decoding happen on the loader's threads, so a loaded image only
+ needs its texture uploaded, which happens the first time it is drawn or its texture is used on the GL thread.
+ */
+class ofxHapImageLoader {
+public:
+    class Request {
+    public:
+        enum State {
+            STATE_PENDING,
+            STATE_LOADED,
+            STATE_FAILED,
+            STATE_CANCELLED
+        };
+
+        State getState() const;
+
+        /*
+         True once the request has loaded, failed or been cancelled
+         */
+        bool isReady() const;
+
+        /*
+         Blocks until the request is ready
+         */
+        void wait() const;
+
+        /*
+         Prevents a request being loaded if it hasn't started, or discards the image if it is being loaded. A cancelled
+         request no longer counts towards the loader's limit or getPendingRequestCount(), though a load in progress
+         occupies its thread until it finishes. Has no effect once the request is ready, so an image returned by
+         getImage() stays valid for the life of the request.
+         */
+        void cancel();
+
+        const std::string& getFilename() const;
+
+        /*
+         The loaded image, only to be used once the state is STATE_LOADED
+         */
+        ofxHapImage& getImage();
+
+    private:
+        friend class ofxHapImageLoader;
+        Request(const std::string& filename);
+        std::string filename_;
+        std::unique_ptr<ofxHapImage> image_;
+        State state_;
+        mutable std::mutex mutex_;
+        mutable std::condition_variable condition_;
+    };
+
+    /*
+     maxPendingRequests limits the number of requests which may be waiting or being loaded at any time.
+     threadCount is the number of threads performing loads. Decoding large images is additionally divided between the
+     threads of ofxHapImage's executor.
+     */
+    ofxHapImageLoader(unsigned int maxPendingRequests = 8, unsigned int threadCount = 1);
+
+    /*
+     Cancels any requests which haven't been loaded and waits for those being loaded to finish
+     */
+    ~ofxHapImageLoader();
+
+    /*
+     Starts loading an image. Returns nullptr if maxPendingRequests requests are already waiting or being loaded.
+     */
+    std::shared_ptr<Request> load(const std::string& filename);
+
+    unsigned int getPendingRequestCount() const;
+
+private:
+    void workerMain();
+    void purgeCancelled();
+    unsigned int pendingCount() const;
+    std::vector<std::thread> threads_;
+    std::deque<std::shared_ptr<Request>> requests_;
+    // Requests being loaded
+    std::vector<std::shared_ptr<Request>> active_;
+    unsigned int max_pending_;
+    mutable std::mutex mutex_;
+    std::condition_variable condition_;
+    bool stop_;
 };
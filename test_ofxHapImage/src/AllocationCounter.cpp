@@ -0,0 +1,70 @@
+#include "tests.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+/*
+ Counts every allocation made through operator new and, where the C library allows it to be interposed, malloc, so
+ allocations made by the Hap library are counted too
+ */
+static std::atomic<unsigned long> count(0);
+
+void *operator new(std::size_t size)
+{
+#if !defined(__GLIBC__)
+    // Where malloc is interposed below it counts this allocation
+    count++;
+#endif
+    void *p = std::malloc(size ? size : 1);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    std::free(p);
+}
+
+#if defined(__GLIBC__)
+extern "C" {
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t n, size_t size);
+    void *__libc_realloc(void *p, size_t size);
+
+    void *malloc(size_t size)
+    {
+        count++;
+        return __libc_malloc(size);
+    }
+
+    void *calloc(size_t n, size_t size)
+    {
+        count++;
+        return __libc_calloc(n, size);
+    }
+
+    void *realloc(void *p, size_t size)
+    {
+        count++;
+        return __libc_realloc(p, size);
+    }
+}
+#endif
+
+unsigned long allocationCount()
+{
+    return count.load();
+}
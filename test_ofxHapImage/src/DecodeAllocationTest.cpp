@@ -0,0 +1,62 @@
+#include "ofMain.h"
+#include "ofxHapImage.h"
+#include "tests.h"
+
+#define kDecodeAllocationTestFrameCount 8
+#define kDecodeAllocationTestRepeats 50
+
+/*
+ Loading an image decodes it. Once the thread pool, the per-thread decode state and the image's own storage have grown
+ to fit the frames, loading a sequence of frames of the same dimensions must not allocate.
+ */
+bool testDecodeAllocations()
+{
+    ofxHapImage::setThreadCount(4);
+    bool passed = true;
+    const unsigned int chunk_counts[] = {1, 16};
+    const ofxHapImage::ImageType types[] = {ofxHapImage::IMAGE_TYPE_HAP, ofxHapImage::IMAGE_TYPE_HAP_ALPHA, ofxHapImage::IMAGE_TYPE_HAP_Q};
+    for (unsigned int chunk_count : chunk_counts)
+    {
+        for (ofxHapImage::ImageType type : types)
+        {
+            // Encode a short sequence of frames to load
+            std::vector<ofBuffer> frames;
+            ofxHapImage encoder;
+            encoder.setEncodeQuality(ofxHapImage::ENCODE_QUALITY_FAST);
+            encoder.setChunkCount(chunk_count);
+            std::vector<unsigned char> pixels(512 * 256 * 4);
+            for (int i = 0; i < kDecodeAllocationTestFrameCount; i++)
+            {
+                for (size_t p = 0; p < pixels.size(); p++)
+                {
+                    pixels[p] = (unsigned char)((p * (i + 1)) >> 6);
+                }
+                encoder.loadImage(pixels.data(), 512, 256, 512 * 4, ofxHapImage::PIXEL_LAYOUT_RGBA, type);
+                frames.push_back(ofBuffer());
+                encoder.saveImage(frames.back());
+            }
+
+            ofxHapImage image;
+            // Warm up
+            for (const ofBuffer& frame : frames)
+            {
+                passed = image.loadImage(frame) && passed;
+            }
+            unsigned long before = allocationCount();
+            for (int repeat = 0; repeat < kDecodeAllocationTestRepeats; repeat++)
+            {
+                for (const ofBuffer& frame : frames)
+                {
+                    passed = image.loadImage(frame) && passed;
+                }
+            }
+            unsigned long allocations = allocationCount() - before;
+            if (allocations != 0)
+            {
+                ofLogError("test_ofxHapImage") << allocations << " allocations loading " << kDecodeAllocationTestRepeats * kDecodeAllocationTestFrameCount << " frames of " << chunk_count << " chunks";
+                passed = false;
+            }
+        }
+    }
+    return passed;
+}
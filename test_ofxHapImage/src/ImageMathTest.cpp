@@ -0,0 +1,118 @@
+#include "ofMain.h"
+#include "tests.h"
+#include <ImageMath.h>
+
+/*
+ The matrices YCoCg.c converts with
+ */
+struct ImageMathTestMatrix {
+    const char *name;
+    int16_t matrix[16];
+    int32_t divisor;
+    int16_t pre_bias[4];
+    int32_t post_bias[4];
+};
+
+static const ImageMathTestMatrix imageMathTestMatrices[] = {
+    {"RGBA to CoCgAY", { 2, -1,  0,  1,   0,  2,  0,  2,  -2, -1,  0,  1,   0,  0,  4,  0}, 4, {0, 0, 0, 0}, {512, 512, 0, 0}},
+    {"CoCgAY to RGBA", { 1,  0, -1,  0,  -1,  1, -1,  0,   0,  0,  0,  1,   1,  1,  1,  0}, 1, {-128, -128, 0, 0}, {0, 0, 0, 0}},
+    {"BGRA to CoCgAY", {-2, -1,  0,  1,   0,  2,  0,  2,   2, -1,  0,  1,   0,  0,  4,  0}, 4, {0, 0, 0, 0}, {512, 512, 0, 0}},
+    {"CoCgAY to BGRA", {-1,  0,  1,  0,  -1,  1, -1,  0,   0,  0,  0,  1,   1,  1,  1,  0}, 1, {-128, -128, 0, 0}, {0, 0, 0, 0}},
+    {"RGBA to CoYCgA", { 2,  1, -1,  0,   0,  2,  2,  0,  -2,  1, -1,  0,   0,  0,  0,  4}, 4, {0, 0, 0, 0}, {512, 0, 512, 0}},
+    {"CoYCgA to RGBA", { 1,  0, -1,  0,   1,  1,  1,  0,  -1,  1, -1,  0,   0,  0,  0,  1}, 1, {-128, 0, -128, 0}, {0, 0, 0, 0}},
+    {"BGRA to CoYCgA", {-2,  1, -1,  0,   0,  2,  2,  0,   2,  1, -1,  0,   0,  0,  0,  4}, 4, {0, 0, 0, 0}, {512, 0, 512, 0}},
+    {"CoYCgA to BGRA", {-1,  0,  1,  0,   1,  1,  1,  0,  -1,  1, -1,  0,   0,  0,  0,  1}, 1, {-128, 0, -128, 0}, {0, 0, 0, 0}},
+};
+
+// Not a multiple of any vector width, so every path's handling of the end of a row is used
+#define kImageMathTestWidth 4099
+#define kImageMathTestRows 256
+
+/*
+ The scalar path of ImageMath_MatrixMultiply8888(), which every other path must match exactly
+ */
+static void imageMathTestReference(const uint8_t *source, uint8_t *destination, const ImageMathTestMatrix& m)
+{
+    int32_t s[4];
+    for (int k = 0; k < 4; k++)
+    {
+        s[k] = source[k] + m.pre_bias[k];
+    }
+    for (int c = 0; c < 4; c++)
+    {
+        int32_t result = (m.matrix[c] * s[0]) + (m.matrix[4 + c] * s[1]) + (m.matrix[8 + c] * s[2]) + (m.matrix[12 + c] * s[3]);
+        result = (result + m.post_bias[c]) / m.divisor;
+        destination[c] = (uint8_t)(result < 0 ? 0 : (result > 255 ? 255 : result));
+    }
+}
+
+static bool imageMathTestExhaustive(ImageMathInstructions path)
+{
+    const uint32_t total = 1U << 24;
+    const size_t stride = (kImageMathTestWidth * 4) + 4;
+    std::vector<uint8_t> source(stride * kImageMathTestRows);
+    std::vector<uint8_t> destination(stride * kImageMathTestRows);
+    bool passed = true;
+    for (const ImageMathTestMatrix& m : imageMathTestMatrices)
+    {
+        unsigned long mismatches = 0;
+        for (uint32_t start = 0; start < total; start += kImageMathTestWidth * kImageMathTestRows)
+        {
+            uint32_t count = std::min<uint32_t>(total - start, kImageMathTestWidth * kImageMathTestRows);
+            unsigned long rows = (count + kImageMathTestWidth - 1) / kImageMathTestWidth;
+            for (uint32_t i = 0; i < rows * kImageMathTestWidth; i++)
+            {
+                // Past the end, repeat values already covered to fill the last row
+                uint32_t value = (start + i) % total;
+                uint8_t *pixel = &source[((i / kImageMathTestWidth) * stride) + ((i % kImageMathTestWidth) * 4)];
+                pixel[0] = (uint8_t)value;
+                pixel[1] = (uint8_t)(value >> 8);
+                pixel[2] = (uint8_t)(value >> 16);
+                pixel[3] = (uint8_t)((value * 2654435761U) >> 24);
+            }
+            ImageMath_MatrixMultiply8888(source.data(), stride, destination.data(), stride, kImageMathTestWidth, rows,
+                                         m.matrix, m.divisor, m.pre_bias, m.post_bias, 0);
+            for (uint32_t i = 0; i < rows * kImageMathTestWidth; i++)
+            {
+                size_t offset = ((i / kImageMathTestWidth) * stride) + ((i % kImageMathTestWidth) * 4);
+                uint8_t expected[4];
+                imageMathTestReference(&source[offset], expected, m);
+                if (memcmp(expected, &destination[offset], 4) != 0)
+                {
+                    if (mismatches == 0)
+                    {
+                        ofLogError("test_ofxHapImage") << m.name << " with instructions " << path << ": first mismatch for input "
+                            << (int)source[offset] << " " << (int)source[offset + 1] << " " << (int)source[offset + 2] << " " << (int)source[offset + 3];
+                    }
+                    mismatches++;
+                }
+            }
+        }
+        if (mismatches != 0)
+        {
+            ofLogError("test_ofxHapImage") << m.name << " with instructions " << path << ": " << mismatches << " pixels differ from the scalar path";
+            passed = false;
+        }
+    }
+    return passed;
+}
+
+/*
+ Converts every one of the 2^24 values of the first three channels with each matrix, with the fourth channel varying,
+ using each set of instructions this machine has
+ */
+bool testImageMathExhaustive()
+{
+    const ImageMathInstructions paths[] = {ImageMathInstructions_Scalar, ImageMathInstructions_Vector, ImageMathInstructions_AVX2};
+    bool passed = true;
+    for (ImageMathInstructions path : paths)
+    {
+        ImageMath_SetInstructionLimit(path);
+        if (ImageMath_GetInstructions() == path)
+        {
+            passed = imageMathTestExhaustive(path) && passed;
+        }
+    }
+    ImageMath_SetInstructionLimit(ImageMathInstructions_AVX2);
+    return passed;
+}
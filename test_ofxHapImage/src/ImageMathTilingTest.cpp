@@ -0,0 +1,86 @@
+#include "ofMain.h"
+#include "ofxHapImage.h"
+#include "tests.h"
+#include <ImageMath.h>
+#include <YCoCg.h>
+#include <atomic>
+
+// Large enough to be divided into many bands, and not a multiple of any vector width
+#define kImageMathTilingTestWidth 1923
+#define kImageMathTilingTestHeight 1083
+
+static std::atomic<unsigned int> imageMathTilingTestBands(0);
+
+static void imageMathTilingTestCallback(ImageMathWorkFunction function, void *p, unsigned int count, void *info)
+{
+    imageMathTilingTestBands += count;
+    static_cast<ofxHapImageExecutor *>(info)->apply(count, [=](unsigned int i) {
+        function(p, i);
+    });
+}
+
+/*
+ With a tile callback installed, conversions permitted to tile are divided into bands of rows performed on several
+ threads. The output must be identical to the same conversion performed in one pass.
+ */
+bool testImageMathTiling()
+{
+    typedef void (*Conversion)(const uint8_t *, uint8_t *, unsigned long, unsigned long, size_t, size_t, int);
+    struct TestConversion {
+        const char *name;
+        Conversion function;
+    };
+    const TestConversion conversions[] = {
+        {"ConvertRGBAToCoCgAY8888", ConvertRGBAToCoCgAY8888},
+        {"ConvertCoCgAY8888ToRGBA", ConvertCoCgAY8888ToRGBA},
+        {"ConvertBGRAToCoCgAY8888", ConvertBGRAToCoCgAY8888},
+        {"ConvertCoCgAY8888ToBGRA", ConvertCoCgAY8888ToBGRA},
+        {"ConvertRGBAToCoYCgA8888", ConvertRGBAToCoYCgA8888},
+        {"ConvertCoYCgA8888ToRGBA", ConvertCoYCgA8888ToRGBA},
+        {"ConvertBGRAToCoYCgA8888", ConvertBGRAToCoYCgA8888},
+        {"ConvertCoYCgA8888ToBGRA", ConvertCoYCgA8888ToBGRA},
+    };
+    const size_t src_stride = (kImageMathTilingTestWidth * 4) + 12;
+    const size_t dst_stride = (kImageMathTilingTestWidth * 4) + 20;
+    std::vector<uint8_t> source(src_stride * kImageMathTilingTestHeight);
+    uint32_t state = 1;
+    for (uint8_t& value : source)
+    {
+        state = (state * 1664525U) + 1013904223U;
+        value = (uint8_t)(state >> 24);
+    }
+    std::vector<uint8_t> untiled(dst_stride * kImageMathTilingTestHeight);
+    std::vector<uint8_t> tiled(dst_stride * kImageMathTilingTestHeight);
+
+    ofxHapImageThreadPool pool(4);
+    ImageMath_SetTileCallback(imageMathTilingTestCallback, &pool);
+    bool passed = true;
+    for (const TestConversion& conversion : conversions)
+    {
+        conversion.function(source.data(), untiled.data(), kImageMathTilingTestWidth, kImageMathTilingTestHeight, src_stride, dst_stride, 0);
+        imageMathTilingTestBands = 0;
+        conversion.function(source.data(), tiled.data(), kImageMathTilingTestWidth, kImageMathTilingTestHeight, src_stride, dst_stride, 1);
+        if (imageMathTilingTestBands < 2)
+        {
+            ofLogError("test_ofxHapImage") << conversion.name << ": wasn't divided into bands";
+            passed = false;
+        }
+        if (untiled != tiled)
+        {
+            ofLogError("test_ofxHapImage") << conversion.name << ": tiled output differs";
+            passed = false;
+        }
+    }
+
+    const uint8_t permute_map[4] = {2, 1, 0, 3};
+    ImageMath_Permute8888(source.data(), src_stride, untiled.data(), dst_stride, kImageMathTilingTestWidth, kImageMathTilingTestHeight, permute_map, 0);
+    imageMathTilingTestBands = 0;
+    ImageMath_Permute8888(source.data(), src_stride, tiled.data(), dst_stride, kImageMathTilingTestWidth, kImageMathTilingTestHeight, permute_map, 1);
+    if (imageMathTilingTestBands < 2 || untiled != tiled)
+    {
+        ofLogError("test_ofxHapImage") << "ImageMath_Permute8888: tiled output differs or wasn't divided into bands";
+        passed = false;
+    }
+    ImageMath_SetTileCallback(NULL, NULL);
+    return passed;
+}
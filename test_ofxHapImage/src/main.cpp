@@ -0,0 +1,29 @@
+#include "ofMain.h"
+#include "tests.h"
+
+/*
+ Runs without a window and exits with a non-zero status if any test fails
+ */
+int main()
+{
+    struct Test {
+        const char *name;
+        bool (*function)();
+    };
+    const Test tests[] = {
+        {"decode allocations", testDecodeAllocations},
+        {"ImageMath exhaustive", testImageMathExhaustive},
+        {"ImageMath tiling", testImageMathTiling},
+    };
+    int failures = 0;
+    for (const Test& test : tests)
+    {
+        bool passed = test.function();
+        ofLogNotice("test_ofxHapImage") << test.name << (passed ? ": passed" : ": FAILED");
+        if (!passed)
+        {
+            failures++;
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+/*
+ The number of allocations made so far by the whole program
+ */
+unsigned long allocationCount();
+
+/*
+ Each test logs what it finds and returns false on failure
+ */
+
+bool testDecodeAllocations();
+bool testImageMathExhaustive();
+bool testImageMathTiling();